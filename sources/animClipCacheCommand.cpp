@@ -0,0 +1,58 @@
+#include <maya/MGlobal.h>
+#include <maya/MArgDatabase.h>
+
+#include "animClipCacheCommand.h"
+#include "applyPlan.h"
+
+ClipCache& getClipCache()
+{
+	static ClipCache cache;
+	return cache;
+}
+
+MSyntax AnimClipCacheCommand::newSyntax()
+{
+	MSyntax syntax;
+	syntax.addFlag("-b", "-budget", MSyntax::MArgType::kDouble); // megabytes
+	syntax.addFlag("-fl", "-flush");
+	syntax.addFlag("-f", "-file", MSyntax::MArgType::kString);
+
+	return syntax;
+}
+
+MStatus AnimClipCacheCommand::doIt(const MArgList& args)
+{
+	MArgDatabase argData(newSyntax(), args);
+	ClipCache &cache = getClipCache();
+
+	if (argData.isFlagSet("-b"))
+	{
+		double budget;
+		argData.getFlagArgument("-b", 0, budget);
+		if (budget < 0)
+		{
+			MGlobal::displayError("-budget(-b) must not be negative");
+			return MS::kFailure;
+		}
+
+		cache.setBudget((size_t)(budget * 1024 * 1024));
+	}
+
+	if (argData.isFlagSet("-fl"))
+	{
+		if (argData.isFlagSet("-f")) // flush a single clip
+		{
+			MString filePath;
+			argData.getFlagArgument("-f", 0, filePath);
+			cache.remove(filePath.asChar());
+		}
+		else
+		{
+			cache.clear();
+			getApplyPlanCache().clear();
+		}
+	}
+
+	setResult(MString(cache.toJson().c_str()));
+	return MS::kSuccess;
+}
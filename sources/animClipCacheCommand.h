@@ -0,0 +1,21 @@
+#include <maya/MPxCommand.h>
+#include <maya/MArgList.h>
+#include <maya/MSyntax.h>
+
+#include "clipCache.h"
+
+// clips decoded by loadAnimClip, shared by all commands of the plugin
+ClipCache& getClipCache();
+
+// Inspects and controls the clip cache. Returns the cache state as json.
+class AnimClipCacheCommand : public MPxCommand
+{
+public:
+	static void* creator() { return new AnimClipCacheCommand(); }
+
+	static MSyntax newSyntax();
+
+	virtual bool isUndoable() const { return false; }
+
+	virtual MStatus doIt(const MArgList& args);
+};
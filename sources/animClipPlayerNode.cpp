@@ -0,0 +1,277 @@
+#include <maya/MFnTypedAttribute.h>
+#include <maya/MFnNumericAttribute.h>
+#include <maya/MFnUnitAttribute.h>
+#include <maya/MFnStringArrayData.h>
+#include <maya/MFnDoubleArrayData.h>
+#include <maya/MArrayDataHandle.h>
+#include <maya/MDoubleArray.h>
+#include <maya/MStringArray.h>
+#include <maya/MAngle.h>
+#include <maya/MDistance.h>
+#include <maya/MTime.h>
+#include <maya/MGlobal.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "clipCache.h"
+#include "animClipCacheCommand.h"
+#include "animClipPlayerNode.h"
+
+using namespace std;
+
+const MTypeId AnimClipPlayerNode::id(0x0007A1C0); // from the range Autodesk leaves to plug-ins which are not distributed
+
+MObject AnimClipPlayerNode::file;
+MObject AnimClipPlayerNode::channels;
+MObject AnimClipPlayerNode::rest;
+MObject AnimClipPlayerNode::time;
+MObject AnimClipPlayerNode::offset;
+MObject AnimClipPlayerNode::speed;
+MObject AnimClipPlayerNode::weight;
+MObject AnimClipPlayerNode::outputUnitless;
+MObject AnimClipPlayerNode::outputLinear;
+MObject AnimClipPlayerNode::outputAngular;
+
+// clip of a file prepared for playback, the evaluator of a channel is made when a player first needs it
+struct PlayerClip
+{
+	shared_ptr<const Clip> clip;
+	FileStamp stamp;
+
+	mutex lock; // players of different characters are evaluated in parallel
+	unordered_map<uint64_t, unique_ptr<CurveEvaluator>> evaluators; // by node index, attribute id and angularity
+
+	const CurveEvaluator* getEvaluator(const string &channel, bool isAngular);
+};
+
+const CurveEvaluator* PlayerClip::getEvaluator(const string &channel, bool isAngular)
+{
+	const size_t dot = channel.rfind('.');
+	if (dot == string::npos)
+		return nullptr;
+
+	const ClipNode *node = clip->findNode(channel.substr(0, dot));
+	const uint32_t attrId = clip->names().find(channel.c_str() + dot + 1, channel.size() - dot - 1);
+	if (!node || attrId == StringTable::NotFound)
+		return nullptr;
+
+	const uint64_t key = (uint64_t)(node - clip->nodes().data()) << 33 | (uint64_t)attrId << 1 | (isAngular ? 1 : 0);
+
+	lock_guard<mutex> guard(lock);
+
+	unique_ptr<CurveEvaluator> &evaluator = evaluators[key];
+	if (evaluator)
+		return evaluator.get();
+
+	// loadAnimClip gives curves CurveEvaluator cannot evaluate an animCurve, such a curve in a changed file keeps its rest value
+	for (const auto &curve : node->curves)
+	{
+		if (curve.attrId == attrId)
+		{
+			if (!canEvaluate(curve.data))
+				return nullptr;
+			evaluator.reset(new CurveEvaluator());
+			evaluator->prepare(curve.data, isAngular);
+			return evaluator.get();
+		}
+	}
+
+	for (const auto &clipChannel : node->channels)
+	{
+		if (clipChannel.attrId == attrId)
+		{
+			evaluator.reset(new CurveEvaluator());
+			evaluator->prepare(clipChannel.data);
+			return evaluator.get();
+		}
+	}
+
+	return nullptr;
+}
+
+static mutex playerClipsLock;
+static unordered_map<string, weak_ptr<PlayerClip>> playerClips;
+
+// players of the same file share its clip while the file is unchanged
+static shared_ptr<PlayerClip> getPlayerClip(const string &filePath, string &error)
+{
+	lock_guard<mutex> guard(playerClipsLock);
+
+	FileStamp stamp;
+	if (!getFileStamp(filePath.c_str(), stamp))
+	{
+		error = "Cannot open file '" + filePath + "'";
+		return nullptr;
+	}
+
+	weak_ptr<PlayerClip> &entry = playerClips[filePath];
+	shared_ptr<PlayerClip> playerClip = entry.lock();
+	if (playerClip && playerClip->stamp == stamp)
+		return playerClip;
+
+	shared_ptr<const Clip> clip = getClipCache().load(filePath.c_str(), error);
+	if (!clip)
+		return nullptr;
+
+	playerClip = make_shared<PlayerClip>();
+	playerClip->clip = clip;
+	playerClip->stamp = stamp;
+	entry = playerClip;
+	return playerClip;
+}
+
+MStatus AnimClipPlayerNode::initialize()
+{
+	MFnTypedAttribute typedFn;
+	MFnNumericAttribute numericFn;
+	MFnUnitAttribute unitFn;
+
+	file = typedFn.create("file", "f", MFnData::kString);
+	channels = typedFn.create("channels", "ch", MFnData::kStringArray);
+	rest = typedFn.create("rest", "rs", MFnData::kDoubleArray);
+
+	time = unitFn.create("time", "tm", MTime(0.0));
+
+	offset = numericFn.create("offset", "of", MFnNumericData::kDouble, 0);
+	numericFn.setKeyable(true);
+
+	speed = numericFn.create("speed", "sp", MFnNumericData::kDouble, 1);
+	numericFn.setKeyable(true);
+
+	weight = numericFn.create("weight", "w", MFnNumericData::kDouble, 1);
+	numericFn.setKeyable(true);
+	numericFn.setMin(0);
+	numericFn.setMax(1);
+
+	// outputs are computed, never saved
+	outputUnitless = numericFn.create("outputUnitless", "ou", MFnNumericData::kDouble, 0);
+	outputLinear = unitFn.create("outputLinear", "ol", MFnUnitAttribute::kDistance, 0);
+	outputAngular = unitFn.create("outputAngular", "oa", MFnUnitAttribute::kAngle, 0);
+
+	for (const MObject &output : { outputUnitless, outputLinear, outputAngular })
+	{
+		MFnAttribute attrFn(output);
+		attrFn.setArray(true);
+		attrFn.setUsesArrayDataBuilder(true);
+		attrFn.setWritable(false);
+		attrFn.setStorable(false);
+	}
+
+	for (const MObject &attr : { file, channels, rest, time, offset, speed, weight, outputUnitless, outputLinear, outputAngular })
+		addAttribute(attr);
+
+	for (const MObject &input : { file, channels, rest, time, offset, speed, weight })
+	{
+		for (const MObject &output : { outputUnitless, outputLinear, outputAngular })
+			attributeAffects(input, output);
+	}
+
+	return MS::kSuccess;
+}
+
+// The clip is loaded again when the file attribute or the file on disk changes, the channels are resolved again when they
+// change. Inputs are compared in compute, as setDependentsDirty is not called for every change under parallel evaluation.
+// The file on disk is checked once per time change rather than for every output, and a file which failed to load is
+// not tried again until the file attribute changes, so its warning is shown once. False when the file cannot be loaded.
+bool AnimClipPlayerNode::update(MDataBlock &data)
+{
+	const MString filePath = data.inputValue(file).asString();
+	const MTime currentTime = data.inputValue(time).asTime();
+
+	bool isClipChanged = filePath != m_filePath;
+	if (!isClipChanged && m_clip && currentTime != m_checkedTime)
+	{
+		FileStamp stamp;
+		isClipChanged = !getFileStamp(filePath.asChar(), stamp) || stamp != m_clip->stamp;
+	}
+	m_checkedTime = currentTime;
+
+	if (isClipChanged)
+	{
+		m_filePath = filePath;
+		m_clip.reset();
+
+		string error;
+		if (filePath.length() > 0)
+			m_clip = getPlayerClip(filePath.asChar(), error);
+		if (!error.empty())
+			MGlobal::displayWarning(name() + ": " + error.c_str());
+	}
+
+	const MObject channelsData = data.inputValue(channels).data();
+	const MStringArray names = channelsData.isNull() ? MStringArray() : MFnStringArrayData(channelsData).array();
+
+	bool isChannelsChanged = isClipChanged || names.length() != m_channels.size();
+	for (unsigned int i = 0; i < names.length() && !isChannelsChanged; i++)
+		isChannelsChanged = names[i] != m_channels[i].name;
+
+	if (isChannelsChanged)
+	{
+		m_channels.resize(names.length());
+		for (unsigned int i = 0; i < names.length(); i++)
+			m_channels[i] = { names[i], { nullptr, nullptr }, { false, false }, 0 };
+	}
+
+	return filePath.length() == 0 || m_clip;
+}
+
+const CurveEvaluator* AnimClipPlayerNode::getEvaluator(Channel &channel, bool isAngular)
+{
+	if (!channel.isResolved[isAngular])
+	{
+		channel.evaluators[isAngular] = m_clip ? m_clip->getEvaluator(channel.name.asChar(), isAngular) : nullptr;
+		channel.isResolved[isAngular] = true;
+	}
+
+	return channel.evaluators[isAngular];
+}
+
+MStatus AnimClipPlayerNode::compute(const MPlug &plug, MDataBlock &data)
+{
+	const MPlug outputPlug = plug.isElement() ? plug.array() : plug;
+	const bool isAngular = outputPlug == outputAngular;
+	const bool isLinear = outputPlug == outputLinear;
+	if (!isAngular && !isLinear && outputPlug != outputUnitless)
+		return MS::kUnknownParameter;
+
+	const bool isLoaded = update(data);
+
+	// clip time in frames of the ui unit
+	const MTime::Unit uiUnit = MTime::uiUnit();
+	const double frame = (data.inputValue(time).asTime().as(uiUnit) - data.inputValue(offset).asDouble()) * data.inputValue(speed).asDouble();
+	const double blend = data.inputValue(weight).asDouble();
+
+	const MObject restData = data.inputValue(rest).data();
+	const MDoubleArray restValues = restData.isNull() ? MDoubleArray() : MFnDoubleArrayData(restData).array();
+
+	MArrayDataHandle outputs = data.outputArrayValue(outputPlug.attribute());
+	for (unsigned int i = 0; i < outputs.elementCount(); i++, outputs.next())
+	{
+		const unsigned int index = outputs.elementIndex();
+		const CurveEvaluator *evaluator = index < m_channels.size() ? getEvaluator(m_channels[index], isAngular) : nullptr;
+
+		// rest values are in internal units, radians for angular outputs
+		double value = index < restValues.length() ? restValues[index] : 0;
+		if (evaluator)
+		{
+			const double curveFrame = evaluator->unit() == (int)uiUnit ? frame : MTime(frame, uiUnit).as((MTime::Unit)evaluator->unit());
+			const double clipValue = evaluator->evaluate(curveFrame, m_channels[index].segment) * (isAngular ? DegreesToRadians : 1);
+			value += (clipValue - value) * blend;
+		}
+
+		MDataHandle output = outputs.outputValue();
+		if (isAngular)
+			output.setMAngle(MAngle(value));
+		else if (isLinear)
+			output.setMDistance(MDistance(value));
+		else
+			output.setDouble(value);
+	}
+
+	outputs.setAllClean();
+
+	// compute may run on an evaluation thread, so a missing file is reported by the status, the outputs keep rest values
+	return isLoaded ? MS::kSuccess : MS::kFailure;
+}
@@ -0,0 +1,57 @@
+#include <maya/MPxNode.h>
+#include <maya/MTypeId.h>
+#include <maya/MPlug.h>
+#include <maya/MPlugArray.h>
+#include <maya/MDataBlock.h>
+#include <maya/MString.h>
+#include <maya/MTime.h>
+
+#include <memory>
+#include <vector>
+
+#include "curveEvaluator.h"
+
+struct PlayerClip;
+
+// Plays curves and baked channels of a clip file without animCurve nodes. Every entry of channels is a "node.attr" of the clip,
+// its output of the kind of the target plug drives the target. The clip data is shared by all players of the same file.
+class AnimClipPlayerNode : public MPxNode
+{
+public:
+	static void* creator() { return new AnimClipPlayerNode(); }
+	static MStatus initialize();
+
+	virtual MStatus compute(const MPlug &plug, MDataBlock &data);
+
+	static const MTypeId id;
+
+	static MObject file;
+	static MObject channels;
+	static MObject rest; // target values, weight blends from them to the clip
+	static MObject time;
+	static MObject offset; // frame the clip starts at
+	static MObject speed;
+	static MObject weight;
+
+	static MObject outputUnitless;
+	static MObject outputLinear;
+	static MObject outputAngular;
+
+private:
+	// evaluator of a channel for unitless or linear and for angular outputs, resolved when first evaluated
+	struct Channel
+	{
+		MString name;
+		const CurveEvaluator *evaluators[2];
+		bool isResolved[2];
+		size_t segment;
+	};
+
+	bool update(MDataBlock &data);
+	const CurveEvaluator* getEvaluator(Channel &channel, bool isAngular);
+
+	MString m_filePath;
+	MTime m_checkedTime; // time the file on disk was last checked at
+	shared_ptr<PlayerClip> m_clip;
+	vector<Channel> m_channels;
+};
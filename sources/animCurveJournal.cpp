@@ -0,0 +1,100 @@
+#include <maya/MFnAnimCurve.h>
+
+#include <cfloat>
+
+#include "animCurveJournal.h"
+#include "utils.h"
+
+bool AnimCurveJournal::reserve(size_t bytes)
+{
+	if (!m_isOverLimit && memorySize() + bytes > m_limit)
+	{
+		clear();
+		m_isOverLimit = true;
+	}
+	return !m_isOverLimit;
+}
+
+size_t AnimCurveJournal::addKeys(const Edit &edit)
+{
+	MFnAnimCurve acFn(edit.animCurve);
+	getAnimCurveFrameData(acFn, m_scratch, edit.start, edit.end);
+
+	CurveData curve;
+	curve.setKeys(m_scratch);
+	curve.weighted = acFn.isWeighted();
+	if (acFn.isTimeInput() && acFn.numKeys() > 0)
+		curve.unit = acFn.time(0).unit();
+
+	if (!reserve(KeyJournal::memorySize(curve)))
+		return NoKeys;
+
+	return m_keys.add(curve);
+}
+
+void AnimCurveJournal::recordBefore(const MObject &animCurve, double start, double end, bool weighted)
+{
+	if (m_isOverLimit || end < start)
+		return;
+
+	if (MFnAnimCurve(animCurve).isWeighted() != weighted)
+	{
+		start = -DBL_MAX;
+		end = DBL_MAX;
+	}
+
+	Edit edit = { animCurve, start, end, NoKeys, NoKeys };
+	edit.before = addKeys(edit);
+	if (reserve(sizeof(Edit)))
+		m_edits.push_back(edit);
+}
+
+void AnimCurveJournal::addCreated(const MObject &animCurve)
+{
+	if (reserve(sizeof(Edit)))
+		m_edits.push_back({ animCurve, -DBL_MAX, DBL_MAX, NoKeys, NoKeys });
+}
+
+void AnimCurveJournal::recordAfter()
+{
+	for (size_t i = 0; i < m_edits.size() && !m_isOverLimit; i++)
+		m_edits[i].after = addKeys(m_edits[i]);
+}
+
+void AnimCurveJournal::restore(const Edit &edit, size_t snapshot) const
+{
+	MFnAnimCurve acFn(edit.animCurve);
+
+	// removed from the last key, so no keys are moved
+	unsigned int first, last;
+	findAnimCurveKeys(acFn, edit.start, edit.end, first, last);
+	for (unsigned int i = last; i > first; i--)
+		acFn.remove(i - 1);
+
+	if (snapshot != NoKeys)
+	{
+		// set even without keys, the edit may have changed the flag of a curve without keys in the range
+		const CurveData keys = m_keys.get(snapshot);
+		acFn.setIsWeighted(keys.weighted);
+		setAnimCurveData(acFn, keys, NULL);
+	}
+}
+
+void AnimCurveJournal::undo() const
+{
+	for (auto edit = m_edits.rbegin(); edit != m_edits.rend(); ++edit)
+		restore(*edit, edit->before);
+}
+
+void AnimCurveJournal::redo() const
+{
+	for (const auto &edit : m_edits)
+		restore(edit, edit.after);
+}
+
+void AnimCurveJournal::clear()
+{
+	m_keys.clear();
+	m_edits = vector<Edit>();
+	m_isOverLimit = false;
+}
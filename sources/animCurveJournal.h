@@ -0,0 +1,66 @@
+#pragma once
+
+#include <maya/MObject.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "keyJournal.h"
+
+using namespace std;
+
+// Undo of key edits: the keys of the frames an edit changes are kept before the edit and once after all edits.
+// Undo and redo write those frames back instead of replaying every key edit like MAnimCurveChange.
+class AnimCurveJournal
+{
+public:
+	AnimCurveJournal() : m_limit(SIZE_MAX), m_isOverLimit(false) {}
+
+	// bytes kept at most, 0 disables the journal
+	void setLimit(size_t limit) { m_limit = limit; }
+	size_t limit() const { return m_limit; }
+
+	// false once the limit is exceeded, then nothing is kept and the edits cannot be undone
+	bool isValid() const { return !m_isOverLimit; }
+
+	size_t memorySize() const { return m_keys.memorySize() + m_edits.size() * sizeof(Edit); }
+
+	// Keys of a curve in [start, end] before an edit of those frames, in the time unit of the curve. An edit changing
+	// the weighted flag of the curve changes the tangents of every key, so then the whole curve is kept.
+	void recordBefore(const MObject &animCurve, double start, double end, bool weighted);
+	// a curve created by the edits, it has no keys before
+	void addCreated(const MObject &animCurve);
+	// keys of the edited frames after all edits
+	void recordAfter();
+
+	// Edits are undone in reverse order, so frames edited twice get back the keys they had before the first edit.
+	// Redone in order, every edit writes back the frames as they were after all edits.
+	void undo() const;
+	void redo() const;
+
+	void clear();
+
+private:
+	static const size_t NoKeys = SIZE_MAX;
+
+	struct Edit
+	{
+		MObject animCurve;
+		double start;
+		double end;
+		size_t before;
+		size_t after;
+	};
+
+	bool reserve(size_t bytes);
+	size_t addKeys(const Edit &edit);
+	void restore(const Edit &edit, size_t snapshot) const;
+
+	KeyJournal m_keys;
+	vector<Edit> m_edits;
+
+	CurveKeys m_scratch;
+
+	size_t m_limit;
+	bool m_isOverLimit;
+};
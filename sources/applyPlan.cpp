@@ -0,0 +1,104 @@
+#include <maya/MDGMessage.h>
+#include <maya/MNodeMessage.h>
+#include <maya/MSceneMessage.h>
+
+#include "applyPlan.h"
+
+// plans keep their clips alive, so only a few are kept
+const size_t MaxApplyPlans = 32;
+
+ApplyPlanCache& getApplyPlanCache()
+{
+	static ApplyPlanCache cache;
+	return cache;
+}
+
+shared_ptr<const ApplyPlan> ApplyPlanCache::find(const string &key) const
+{
+	const auto found = m_plans.find(key);
+	return found != m_plans.end() ? found->second : nullptr;
+}
+
+void ApplyPlanCache::add(const string &key, const shared_ptr<const ApplyPlan> &plan)
+{
+	if (m_plans.size() >= MaxApplyPlans && !m_plans.count(key))
+		m_plans.clear();
+
+	// clear is called from callbacks, which cannot remove themselves, so the nodes of dropped plans are unwatched here
+	if (m_plans.empty())
+		unwatchNodes();
+
+	for (const MObject &node : plan->nodes)
+		watchNode(node);
+
+	m_plans[key] = plan;
+}
+
+static void onNodeChanged(MObject&, void*)
+{
+	getApplyPlanCache().clear();
+}
+
+static void onNameChanged(MObject&, const MString&, void*)
+{
+	getApplyPlanCache().clear();
+}
+
+static void onConnectionChanged(MPlug&, MPlug&, bool, void*)
+{
+	getApplyPlanCache().clear();
+}
+
+static void onSceneChanged(void*)
+{
+	getApplyPlanCache().clear();
+}
+
+static void onAttributeAddedOrRemoved(MNodeMessage::AttributeMessage, MPlug&, void*)
+{
+	getApplyPlanCache().clear();
+}
+
+void ApplyPlanCache::watchNode(const MObject &node)
+{
+	const MObjectHandle handle(node);
+	vector<MObjectHandle> &nodes = m_watchedNodes[handle.hashCode()];
+	for (const auto &watched : nodes)
+	{
+		if (watched == handle)
+			return;
+	}
+
+	nodes.push_back(handle);
+
+	MObject nodeObj(node);
+	m_nodeCallbacks.append(MNodeMessage::addAttributeAddedOrRemovedCallback(nodeObj, onAttributeAddedOrRemoved));
+}
+
+void ApplyPlanCache::unwatchNodes()
+{
+	MMessage::removeCallbacks(m_nodeCallbacks);
+	m_nodeCallbacks.clear();
+	m_watchedNodes.clear();
+}
+
+void ApplyPlanCache::addCallbacks()
+{
+	MObject allNodes;
+	m_callbacks.append(MDGMessage::addNodeAddedCallback(onNodeChanged));
+	m_callbacks.append(MDGMessage::addNodeRemovedCallback(onNodeChanged));
+	m_callbacks.append(MDGMessage::addConnectionCallback(onConnectionChanged));
+	m_callbacks.append(MNodeMessage::addNameChangedCallback(allNodes, onNameChanged));
+
+	for (auto message : { MSceneMessage::kBeforeNew, MSceneMessage::kBeforeOpen, MSceneMessage::kAfterLoadReference,
+		MSceneMessage::kAfterUnloadReference, MSceneMessage::kBeforeRemoveReference })
+		m_callbacks.append(MSceneMessage::addCallback(message, onSceneChanged));
+}
+
+void ApplyPlanCache::removeCallbacks()
+{
+	MMessage::removeCallbacks(m_callbacks);
+	m_callbacks.clear();
+	unwatchNodes();
+	clear();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <maya/MObject.h>
+#include <maya/MObjectHandle.h>
+#include <maya/MPlug.h>
+#include <maya/MString.h>
+#include <maya/MMessage.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "clip.h"
+
+using namespace std;
+
+// Curves, channels and statics of a clip resolved to the plugs they are applied to, with the curves already driving them.
+// Applying a plan only inserts keys, the scene is not searched for nodes, plugs and curves again.
+struct ApplyPlan
+{
+	struct Target
+	{
+		MObject node;
+		MPlug plug;
+		MObject animCurve; // null if the plug is not animated
+		MString clipNode;
+		MString attr;
+		size_t group; // index of the namespace, keys are shifted by its time offset
+
+		// the data applied, one of them is set
+		const CurveData *curve;
+		const ChannelData *channel;
+		const ClipStatic *staticValue;
+	};
+
+	shared_ptr<const Clip> clip; // data of the targets points into it
+	string filterKey; // the clip is cached under it
+	vector<Target> targets;
+	vector<MString> warnings; // of the resolution, shown again on every application
+	vector<MObject> nodes; // found in the clip, their attributes are watched while the plan is cached
+};
+
+// Plans by clip file and target nodes. Nodes, plugs and curves a plan refers to may change with any edit of the graph,
+// so all plans are dropped when nodes are added, removed or renamed, attributes are added to or removed from the nodes
+// of a plan, connections change or another scene is opened.
+class ApplyPlanCache
+{
+public:
+	ApplyPlanCache() {}
+
+	ApplyPlanCache(const ApplyPlanCache&) = delete;
+	ApplyPlanCache& operator=(const ApplyPlanCache&) = delete;
+
+	// the plan is valid only for the clip it was made for, a changed file is loaded as another clip
+	shared_ptr<const ApplyPlan> find(const string &key) const;
+	void add(const string &key, const shared_ptr<const ApplyPlan> &plan);
+
+	void clear() { m_plans.clear(); }
+	size_t size() const { return m_plans.size(); }
+
+	void addCallbacks();
+	void removeCallbacks();
+
+private:
+	void watchNode(const MObject &node);
+	void unwatchNodes();
+
+	unordered_map<string, shared_ptr<const ApplyPlan>> m_plans;
+	MCallbackIdArray m_callbacks;
+
+	// attribute callbacks of the nodes of cached plans, by object hash, nodes sharing a hash are told apart by handle
+	unordered_map<unsigned int, vector<MObjectHandle>> m_watchedNodes;
+	MCallbackIdArray m_nodeCallbacks;
+};
+
+// plans made by loadAnimClip
+ApplyPlanCache& getApplyPlanCache();
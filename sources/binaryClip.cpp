@@ -0,0 +1,833 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "binaryClip.h"
+
+// ticks per frame tried for quantized times, so whole frames and common subframes are exact
+const uint32_t TicksPerFrame[] = { 1, 2, 3, 4, 5, 6, 8, 10, 12, 16, 20, 24, 25, 30, 50, 60, 100, 120, 1000, 6000 };
+
+// largest integer a double holds exactly
+const double MaxQuantized = 4503599627370496.0;
+
+static void appendVarint(string &bytes, int64_t value)
+{
+	uint64_t v = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63); // zigzag, small magnitudes get few bytes
+	while (v >= 0x80)
+	{
+		bytes.push_back((char)(v | 0x80));
+		v >>= 7;
+	}
+	bytes.push_back((char)v);
+}
+
+static bool readVarint(const uint8_t *&p, const uint8_t *end, int64_t &value)
+{
+	uint64_t v = 0;
+	for (int shift = 0; shift < 64 && p < end; shift += 7)
+	{
+		const uint8_t byte = *p++;
+		v |= (uint64_t)(byte & 0x7f) << shift;
+		if (byte < 0x80)
+		{
+			value = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+static void appendDoubles(string &bytes, const double *values, size_t numValues)
+{
+	bytes.assign((const char*)values, numValues * sizeof(double));
+}
+
+// zero if some time is not a whole number of ticks for every candidate rate
+static uint32_t quantizeTimes(const double *times, size_t numKeys, string &bytes)
+{
+	for (uint32_t ticksPerFrame : TicksPerFrame)
+	{
+		bytes.clear();
+
+		int64_t previous = 0;
+		size_t i = 0;
+		for (; i < numKeys; i++)
+		{
+			const double ticks = times[i] * ticksPerFrame;
+			if (!(fabs(ticks) < MaxQuantized))
+				break;
+
+			const int64_t tick = llround(ticks);
+			if (fabs((double)tick / ticksPerFrame - times[i]) > 1e-9 * max(1.0, fabs(times[i])))
+				break;
+
+			appendVarint(bytes, tick - previous);
+			previous = tick;
+		}
+
+		if (i == numKeys)
+			return ticksPerFrame;
+	}
+
+	appendDoubles(bytes, times, numKeys);
+	return 0;
+}
+
+// every value is checked to be restored within the tolerance, the values are stored as doubles otherwise
+static double quantizeValues(const double *values, size_t numValues, double tolerance, double origin, string &bytes)
+{
+	const double quantum = 2 * tolerance;
+
+	bytes.clear();
+
+	int64_t previous = 0;
+	size_t i = 0;
+	for (; i < numValues; i++)
+	{
+		const double steps = (values[i] - origin) / quantum;
+		if (!(fabs(steps) < MaxQuantized))
+			break;
+
+		const int64_t step = llround(steps);
+		if (!(fabs(origin + step * quantum - values[i]) <= tolerance))
+			break;
+
+		appendVarint(bytes, step - previous);
+		previous = step;
+	}
+
+	if (i == numValues)
+		return quantum;
+
+	appendDoubles(bytes, values, numValues);
+	return 0;
+}
+
+// decodes a column written by quantizeTimes or quantizeValues
+static bool dequantize(const char *data, size_t size, size_t numValues, double origin, double scale, vector<double> &values)
+{
+	values.resize(numValues);
+
+	if (scale == 0)
+	{
+		if (size != numValues * sizeof(double))
+			return false;
+
+		memcpy(values.data(), data, size);
+		return true;
+	}
+
+	const uint8_t *p = (const uint8_t*)data;
+	const uint8_t *end = p + size;
+
+	int64_t step = 0;
+	for (size_t i = 0; i < numValues; i++)
+	{
+		int64_t delta;
+		if (!readVarint(p, end, delta))
+			return false;
+
+		step += delta;
+		values[i] = origin + step * scale;
+	}
+
+	return p == end;
+}
+
+static uint64_t rotl(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t mix64(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdull;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ull;
+	x ^= x >> 33;
+	return x;
+}
+
+// two lanes over 8 byte words, each with its own constants
+ContentHash hashContent(const void *data, size_t size, uint64_t seed)
+{
+	const uint64_t k1 = 0x9e3779b97f4a7c15ull;
+	const uint64_t k2 = 0x87c37b91114253d5ull;
+
+	const char *bytes = (const char*)data;
+	uint64_t a = seed ^ k1;
+	uint64_t b = seed ^ k2;
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+		a = rotl(a ^ word * k1, 31) * k2;
+		b = rotl(b ^ word * k2, 27) * k1 + a;
+	}
+
+	uint64_t tail = 0;
+	memcpy(&tail, bytes + i, size - i);
+	a = rotl(a ^ tail * k1, 31) * k2;
+	b = rotl(b ^ tail * k2, 27) * k1 + a;
+
+	ContentHash hash;
+	hash.low = mix64(a ^ size);
+	hash.high = mix64(b ^ hash.low);
+	return hash;
+}
+
+string toString(const ContentHash &hash)
+{
+	char str[33];
+	snprintf(str, sizeof(str), "%016llx%016llx", (unsigned long long)hash.high, (unsigned long long)hash.low);
+	return str;
+}
+
+// directory with a trailing separator, a relative store directory is relative to the directory of the clip
+static string resolveStorePath(const string &clipPath, const string &store)
+{
+	const bool isAbsolute = !store.empty() && (store[0] == '/' || store[0] == '\\' || (store.size() > 1 && store[1] == ':'));
+
+	string path = store;
+	if (!isAbsolute)
+	{
+		const size_t slash = clipPath.find_last_of("/\\");
+		path = (slash == string::npos ? string() : clipPath.substr(0, slash + 1)) + store;
+	}
+
+	if (path.empty() || (path.back() != '/' && path.back() != '\\'))
+		path += '/';
+
+	return path;
+}
+
+static void createDirectory(const string &path)
+{
+#ifdef _WIN32
+	_mkdir(path.c_str());
+#else
+	mkdir(path.c_str(), 0777);
+#endif
+}
+
+// a store file is reused only when it holds exactly the keys, the hash alone may collide
+static bool hasSameContent(const string &filePath, const string &bytes)
+{
+	MappedFile file;
+	return file.open(filePath.c_str()) && file.size() == bytes.size() && memcmp(file.data(), bytes.data(), bytes.size()) == 0;
+}
+
+BinaryClipWriter::BinaryClipWriter() : m_numTempFiles(0), m_storeString(0)
+{
+}
+
+BinaryClipWriter::~BinaryClipWriter()
+{
+	discard();
+}
+
+bool BinaryClipWriter::open(const char *filePath)
+{
+	discard();
+
+	if (!m_output.open(filePath))
+		return false;
+
+	m_strings.clear();
+	m_nodes.clear();
+	m_curves.clear();
+	m_channels.clear();
+	m_statics.clear();
+	m_writtenKeys.clear();
+	m_writtenBytes.clear();
+	m_storedFiles.clear();
+
+	m_storePath.clear();
+	if (!m_store.empty())
+	{
+		m_storePath = resolveStorePath(filePath, m_store);
+		m_storeString = addString(m_store.c_str());
+		createDirectory(m_storePath);
+	}
+
+	BinaryClipHeader header = {};
+	memcpy(header.magic, BinaryClipMagic, sizeof(header.magic));
+	header.version = BinaryClipVersion;
+	write(&header, sizeof(header));
+	return true;
+}
+
+void BinaryClipWriter::write(const void *data, size_t size)
+{
+	m_output.write(data, size);
+}
+
+void BinaryClipWriter::align()
+{
+	const char zeros[8] = {};
+	write(zeros, (8 - m_output.tell() % 8) % 8);
+}
+
+uint32_t BinaryClipWriter::addString(const char *str)
+{
+	return m_strings.offset(m_strings.intern(str));
+}
+
+void BinaryClipWriter::beginNode(const char *name)
+{
+	BinaryClipNode node = {};
+	node.name = addString(name);
+	node.firstCurve = (uint32_t)m_curves.size();
+	node.firstStatic = (uint32_t)m_statics.size();
+	node.firstChannel = (uint32_t)m_channels.size();
+	m_nodes.push_back(node);
+}
+
+void BinaryClipWriter::writeCurve(const char *attr, const CurveData &curve)
+{
+	BinaryClipCurve record = {};
+	record.attr = addString(attr);
+	record.weighted = curve.weighted;
+	record.preInfinity = (uint8_t)curve.preInfinity;
+	record.postInfinity = (uint8_t)curve.postInfinity;
+	record.unit = curve.unit;
+	record.numKeys = (uint32_t)curve.numKeys;
+	record.numFixedTangents = (uint32_t)curve.numFixedTangents;
+
+	m_keys.clear();
+	if (curve.tolerance > 0)
+	{
+		record.encoding = BinaryQuantizedEncoding;
+		appendQuantized(curve.times, curve.values, curve.numKeys, curve.tolerance);
+	}
+	else
+	{
+		m_keys.append((const char*)curve.times, curve.numKeys * sizeof(double));
+		m_keys.append((const char*)curve.values, curve.numKeys * sizeof(double));
+	}
+
+	m_keys.append((const char*)curve.inTangentTypes, curve.numKeys);
+	m_keys.append((const char*)curve.outTangentTypes, curve.numKeys);
+	m_keys.resize((m_keys.size() + 7) / 8 * 8, '\0');
+	m_keys.append((const char*)curve.fixedTangents, curve.numFixedTangents * sizeof(FixedTangent));
+
+	record.keysOffset = writeKeys(record.encoding);
+
+	m_curves.push_back(record);
+	m_nodes.back().numCurves++;
+}
+
+void BinaryClipWriter::writeChannel(const char *attr, const ChannelData &channel)
+{
+	BinaryClipChannel record = {};
+	record.attr = addString(attr);
+	record.unit = channel.unit;
+	record.numValues = (uint32_t)channel.numValues;
+	record.start = channel.start;
+	record.step = channel.step;
+
+	m_keys.clear();
+	if (channel.tolerance > 0)
+	{
+		record.encoding = BinaryQuantizedEncoding;
+		appendQuantized(nullptr, channel.values, channel.numValues, channel.tolerance);
+	}
+	else
+		m_keys.append((const char*)channel.values, channel.numValues * sizeof(double));
+
+	record.valuesOffset = writeKeys(record.encoding);
+
+	m_channels.push_back(record);
+	m_nodes.back().numChannels++;
+}
+
+// times are omitted for channels, their samples are uniform
+void BinaryClipWriter::appendQuantized(const double *times, const double *values, size_t numValues, double tolerance)
+{
+	BinaryQuantizedKeys header = {};
+	header.valueOrigin = numValues > 0 ? values[0] : 0;
+
+	m_times.clear();
+	if (times)
+		header.ticksPerFrame = quantizeTimes(times, numValues, m_times);
+
+	header.valueQuantum = quantizeValues(values, numValues, tolerance, header.valueOrigin, m_values);
+	header.timesSize = (uint32_t)m_times.size();
+	header.valuesSize = (uint32_t)m_values.size();
+
+	m_keys.append((const char*)&header, sizeof(header));
+	m_keys.append(m_times);
+	m_keys.append(m_values);
+}
+
+// Writes the current keys unless identical keys were written before, returns their offset. The encoding becomes
+// BinaryStoredEncoding when the keys are in the curve store.
+uint64_t BinaryClipWriter::writeKeys(uint8_t &encoding)
+{
+	const ContentHash hash = hashContent(m_keys.data(), m_keys.size(), encoding);
+
+	const auto range = m_writtenKeys.equal_range(hash);
+	for (auto found = range.first; found != range.second; ++found)
+	{
+		if (isWritten(found->second))
+		{
+			encoding = found->second.encoding;
+			return found->second.offset;
+		}
+	}
+
+	align();
+
+	WrittenKeys written = { m_output.tell(), encoding, m_keys.size(), m_writtenBytes.size() };
+	m_writtenBytes.append(m_keys);
+	if (!m_storePath.empty() && !m_keys.empty() && storeKeys(hash))
+	{
+		BinaryStoredKeys stored = {};
+		stored.hash = hash;
+		stored.size = m_keys.size();
+		stored.store = m_storeString;
+		stored.encoding = encoding;
+		write(&stored, sizeof(stored));
+
+		written.encoding = BinaryStoredEncoding;
+	}
+	else
+		write(m_keys.data(), m_keys.size());
+
+	m_writtenKeys.emplace(hash, written);
+	encoding = written.encoding;
+	return written.offset;
+}
+
+// whether the current keys are the written ones, compared with the copy kept in memory, so a hit reads no file
+bool BinaryClipWriter::isWritten(const WrittenKeys &written) const
+{
+	return written.size == m_keys.size() && memcmp(m_writtenBytes.data() + written.bytesOffset, m_keys.data(), m_keys.size()) == 0;
+}
+
+// Keys already in the store are reused, others are written to a temporary file renamed into place, so concurrent
+// writers never expose a partial file. Returns false when the keys have to be written to the clip instead.
+bool BinaryClipWriter::storeKeys(const ContentHash &hash)
+{
+	const string filePath = m_storePath + toString(hash) + BinaryStoreExtension;
+
+	FILE *f = fopen(filePath.c_str(), "rb");
+	if (f)
+	{
+		fclose(f);
+		return hasSameContent(filePath, m_keys);
+	}
+
+	const string tempPath = filePath + getTempSuffix(this, m_numTempFiles++);
+	f = fopen(tempPath.c_str(), "wb");
+	if (!f)
+		return false;
+
+	const bool isWritten = fwrite(m_keys.data(), 1, m_keys.size(), f) == m_keys.size();
+	if (fclose(f) != 0 || !isWritten || rename(tempPath.c_str(), filePath.c_str()) != 0)
+	{
+		remove(tempPath.c_str());
+
+		return hasSameContent(filePath, m_keys); // stored by another writer meanwhile
+	}
+	else
+		m_storedFiles.push_back(filePath);
+
+	return true;
+}
+
+void BinaryClipWriter::writeStatic(const char *attr, double value)
+{
+	BinaryClipStatic record = {};
+	record.attr = addString(attr);
+	record.value = value;
+
+	m_statics.push_back(record);
+	m_nodes.back().numStatics++;
+}
+
+void BinaryClipWriter::endNode()
+{
+}
+
+bool BinaryClipWriter::close()
+{
+	if (!m_output.isOpen())
+		return false;
+
+	BinaryClipFooter footer = {};
+
+	footer.stringTableOffset = m_output.tell();
+	const string strings = m_strings.data();
+	footer.stringTableSize = strings.size();
+	write(strings.data(), strings.size());
+	align();
+
+	footer.nodeTableOffset = m_output.tell();
+	footer.nodeCount = (uint32_t)m_nodes.size();
+	write(m_nodes.data(), m_nodes.size() * sizeof(BinaryClipNode));
+
+	footer.curveTableOffset = m_output.tell();
+	footer.curveCount = (uint32_t)m_curves.size();
+	write(m_curves.data(), m_curves.size() * sizeof(BinaryClipCurve));
+
+	footer.channelTableOffset = m_output.tell();
+	footer.channelCount = (uint32_t)m_channels.size();
+	write(m_channels.data(), m_channels.size() * sizeof(BinaryClipChannel));
+
+	footer.staticTableOffset = m_output.tell();
+	footer.staticCount = (uint32_t)m_statics.size();
+	write(m_statics.data(), m_statics.size() * sizeof(BinaryClipStatic));
+
+	memcpy(footer.magic, BinaryClipMagic, sizeof(footer.magic));
+	write(&footer, sizeof(footer));
+
+	return m_output.close();
+}
+
+static bool isInside(uint64_t offset, uint64_t size, size_t fileSize)
+{
+	return offset <= fileSize && size <= fileSize - offset;
+}
+
+// tangent types index TangentTypes and fixed tangents are matched to keys in key order
+static bool isValidTangents(const CurveData &curve)
+{
+	for (size_t i = 0; i < curve.numKeys; i++)
+	{
+		if (curve.inTangentTypes[i] > TangentAuto || curve.outTangentTypes[i] > TangentAuto)
+			return false;
+	}
+
+	for (size_t i = 0; i < curve.numFixedTangents; i++)
+	{
+		if (curve.fixedTangents[i].key >= curve.numKeys || (i > 0 && curve.fixedTangents[i].key <= curve.fixedTangents[i - 1].key))
+			return false;
+	}
+	return true;
+}
+
+// Keys shared by several records are looked up and decoded once
+class BinaryKeysReader
+{
+public:
+	BinaryKeysReader(Clip &clip, const char *strings, uint64_t stringTableSize, uint32_t version) : m_clip(clip), m_strings(strings), m_stringTableSize(stringTableSize),
+		m_maxEncoding(version >= 4 ? BinaryStoredEncoding : version >= 3 ? BinaryQuantizedEncoding : BinaryRawEncoding) {}
+
+	bool readCurve(const BinaryClipCurve &record, CurveData &curve, string &error);
+	bool readChannel(const BinaryClipChannel &record, ChannelData &channel, string &error);
+
+private:
+	bool findKeys(uint64_t offset, uint8_t &encoding, const char *&keys, uint64_t &size, string &error);
+
+	Clip &m_clip;
+	const char *m_strings;
+	uint64_t m_stringTableSize;
+	uint8_t m_maxEncoding; // encodings added after the version of the clip are corruption
+
+	unordered_map<string, MappedFile*> m_storeFiles;
+	unordered_map<const char*, CurveKeys*> m_curveKeys;
+	unordered_map<const char*, vector<double>*> m_channelValues;
+};
+
+// keys are either in the clip file or in a file of the curve store, size is the number of bytes available to them
+bool BinaryKeysReader::findKeys(uint64_t offset, uint8_t &encoding, const char *&keys, uint64_t &size, string &error)
+{
+	const char *data = m_clip.file().data();
+	const size_t fileSize = m_clip.file().size();
+
+	if (offset % 8 || offset > fileSize || encoding > m_maxEncoding)
+	{
+		error = "Corrupted binary clip";
+		return false;
+	}
+
+	if (encoding != BinaryStoredEncoding)
+	{
+		keys = data + offset;
+		size = fileSize - offset;
+		return true;
+	}
+
+	const BinaryStoredKeys *stored = (const BinaryStoredKeys*)(data + offset);
+	if (!isInside(offset, sizeof(BinaryStoredKeys), fileSize) || stored->store >= m_stringTableSize || stored->encoding > BinaryQuantizedEncoding)
+	{
+		error = "Corrupted binary clip";
+		return false;
+	}
+
+	const string filePath = resolveStorePath(m_clip.filePath(), m_strings + stored->store) + toString(stored->hash) + BinaryStoreExtension;
+
+	auto found = m_storeFiles.find(filePath);
+	if (found == m_storeFiles.end())
+	{
+		MappedFile &file = m_clip.addFile();
+		if (!file.open(filePath.c_str()))
+		{
+			error = "Cannot open curve store file '" + filePath + "'";
+			return false;
+		}
+
+		found = m_storeFiles.emplace(filePath, &file).first;
+	}
+
+	if (found->second->size() != stored->size)
+	{
+		error = "Corrupted curve store file '" + filePath + "'";
+		return false;
+	}
+
+	keys = found->second->data();
+	size = stored->size;
+	encoding = stored->encoding;
+	return true;
+}
+
+bool BinaryKeysReader::readCurve(const BinaryClipCurve &record, CurveData &curve, string &error)
+{
+	uint8_t encoding = record.encoding;
+	const char *keys;
+	uint64_t size;
+	if (!findKeys(record.keysOffset, encoding, keys, size, error))
+		return false;
+
+	const bool isQuantized = encoding == BinaryQuantizedEncoding;
+	const BinaryQuantizedKeys *quantized = (const BinaryQuantizedKeys*)keys;
+
+	if (isQuantized && size < sizeof(BinaryQuantizedKeys))
+	{
+		error = "Corrupted binary clip";
+		return false;
+	}
+
+	const uint64_t keysSize = isQuantized ? sizeof(BinaryQuantizedKeys) + (uint64_t)quantized->timesSize + quantized->valuesSize : (uint64_t)record.numKeys * 2 * sizeof(double);
+	const uint64_t columnsSize = keysSize + (uint64_t)record.numKeys * 2;
+	const uint64_t fixedOffset = (columnsSize + 7) / 8 * 8;
+
+	if (!isInside(0, columnsSize, size) || !isInside(fixedOffset, (uint64_t)record.numFixedTangents * sizeof(FixedTangent), size))
+	{
+		error = "Corrupted binary clip";
+		return false;
+	}
+
+	curve.numKeys = record.numKeys;
+	curve.times = (const double*)keys;
+	curve.values = (const double*)(keys + record.numKeys * sizeof(double));
+	curve.inTangentTypes = (const uint8_t*)(keys + keysSize);
+	curve.outTangentTypes = curve.inTangentTypes + record.numKeys;
+	curve.numFixedTangents = record.numFixedTangents;
+	curve.fixedTangents = (const FixedTangent*)(keys + fixedOffset);
+
+	if (!isValidTangents(curve))
+	{
+		error = "Corrupted binary clip";
+		return false;
+	}
+
+	if (isQuantized)
+	{
+		CurveKeys *&decoded = m_curveKeys[keys];
+		if (!decoded)
+		{
+			const char *times = keys + sizeof(BinaryQuantizedKeys);
+			const double tickFrames = quantized->ticksPerFrame ? 1.0 / quantized->ticksPerFrame : 0;
+
+			decoded = &m_clip.addKeys();
+			if (!dequantize(times, quantized->timesSize, record.numKeys, 0, tickFrames, decoded->times) ||
+				!dequantize(times + quantized->timesSize, quantized->valuesSize, record.numKeys, quantized->valueOrigin, quantized->valueQuantum, decoded->values))
+			{
+				error = "Corrupted binary clip";
+				return false;
+			}
+		}
+		else if (decoded->times.size() != record.numKeys)
+		{
+			error = "Corrupted binary clip";
+			return false;
+		}
+
+		curve.times = decoded->times.data();
+		curve.values = decoded->values.data();
+		curve.tolerance = quantized->valueQuantum / 2;
+	}
+
+	return true;
+}
+
+bool BinaryKeysReader::readChannel(const BinaryClipChannel &record, ChannelData &channel, string &error)
+{
+	uint8_t encoding = record.encoding;
+	const char *keys;
+	uint64_t size;
+	if (!findKeys(record.valuesOffset, encoding, keys, size, error))
+		return false;
+
+	const bool isQuantized = encoding == BinaryQuantizedEncoding;
+	const BinaryQuantizedKeys *quantized = (const BinaryQuantizedKeys*)keys;
+
+	if ((isQuantized && (size < sizeof(BinaryQuantizedKeys) || !isInside(sizeof(BinaryQuantizedKeys), quantized->valuesSize, size))) ||
+		(!isQuantized && !isInside(0, (uint64_t)record.numValues * sizeof(double), size)))
+	{
+		error = "Corrupted binary clip";
+		return false;
+	}
+
+	channel.numValues = record.numValues;
+	channel.values = (const double*)keys;
+
+	if (isQuantized)
+	{
+		vector<double> *&decoded = m_channelValues[keys];
+		if (!decoded)
+		{
+			decoded = &m_clip.addValues();
+			if (!dequantize(keys + sizeof(BinaryQuantizedKeys), quantized->valuesSize, record.numValues, quantized->valueOrigin, quantized->valueQuantum, *decoded))
+			{
+				error = "Corrupted binary clip";
+				return false;
+			}
+		}
+		else if (decoded->size() != record.numValues)
+		{
+			error = "Corrupted binary clip";
+			return false;
+		}
+
+		channel.values = decoded->data();
+		channel.tolerance = quantized->valueQuantum / 2;
+	}
+
+	return true;
+}
+
+bool readBinaryClip(Clip &clip, string &error, const ClipNodeFilter &filter)
+{
+	const char *data = clip.file().data();
+	const size_t size = clip.file().size();
+
+	if (!isBinaryClip(data, size) || size < sizeof(BinaryClipHeader) + sizeof(BinaryClipFooter))
+	{
+		error = "Not a binary clip";
+		return false;
+	}
+
+	const BinaryClipHeader *header = (const BinaryClipHeader*)data;
+	if (header->version < 2 || header->version > BinaryClipVersion)
+	{
+		error = "Unsupported binary clip version " + to_string(header->version);
+		return false;
+	}
+
+	const BinaryClipFooter *footer = (const BinaryClipFooter*)(data + size - sizeof(BinaryClipFooter));
+	if (memcmp(footer->magic, BinaryClipMagic, sizeof(BinaryClipMagic)) != 0 ||
+		!isInside(footer->stringTableOffset, footer->stringTableSize, size) ||
+		!isInside(footer->nodeTableOffset, (uint64_t)footer->nodeCount * sizeof(BinaryClipNode), size) ||
+		!isInside(footer->curveTableOffset, (uint64_t)footer->curveCount * sizeof(BinaryClipCurve), size) ||
+		!isInside(footer->staticTableOffset, (uint64_t)footer->staticCount * sizeof(BinaryClipStatic), size) ||
+		!isInside(footer->channelTableOffset, (uint64_t)footer->channelCount * sizeof(BinaryClipChannel), size) ||
+		footer->nodeTableOffset % 8 || footer->curveTableOffset % 8 || footer->staticTableOffset % 8 || footer->channelTableOffset % 8 ||
+		(footer->stringTableSize > 0 && data[footer->stringTableOffset + footer->stringTableSize - 1] != '\0'))
+	{
+		error = "Corrupted binary clip";
+		return false;
+	}
+
+	const char *strings = data + footer->stringTableOffset;
+	const BinaryClipNode *nodes = (const BinaryClipNode*)(data + footer->nodeTableOffset);
+	const BinaryClipCurve *curves = (const BinaryClipCurve*)(data + footer->curveTableOffset);
+	const BinaryClipStatic *statics = (const BinaryClipStatic*)(data + footer->staticTableOffset);
+	const BinaryClipChannel *channels = (const BinaryClipChannel*)(data + footer->channelTableOffset);
+
+	BinaryKeysReader keysReader(clip, strings, footer->stringTableSize, header->version);
+
+	// names are interned in place, the string table of the file is terminated
+	auto addName = [&](uint32_t offset) { return clip.addName(strings + offset, strlen(strings + offset), false); };
+
+	for (uint32_t i = 0; i < footer->nodeCount; i++)
+	{
+		const BinaryClipNode &node = nodes[i];
+		if (node.name >= footer->stringTableSize ||
+			(uint64_t)node.firstCurve + node.numCurves > footer->curveCount ||
+			(uint64_t)node.firstStatic + node.numStatics > footer->staticCount ||
+			(uint64_t)node.firstChannel + node.numChannels > footer->channelCount)
+		{
+			error = "Corrupted binary clip";
+			return false;
+		}
+
+		if (filter && !filter(strings + node.name))
+			continue;
+
+		ClipNode &clipNode = clip.addNode(addName(node.name));
+
+		clipNode.curves.reserve(node.numCurves);
+		for (uint32_t k = node.firstCurve; k < node.firstCurve + node.numCurves; k++)
+		{
+			const BinaryClipCurve &curve = curves[k];
+			if (curve.attr >= footer->stringTableSize)
+			{
+				error = "Corrupted binary clip";
+				return false;
+			}
+
+			ClipCurve clipCurve;
+			clipCurve.attr = strings + curve.attr;
+			clipCurve.attrId = addName(curve.attr);
+			clipCurve.data.weighted = curve.weighted != 0;
+			clipCurve.data.preInfinity = curve.preInfinity;
+			clipCurve.data.postInfinity = curve.postInfinity;
+			clipCurve.data.unit = curve.unit;
+
+			if (!keysReader.readCurve(curve, clipCurve.data, error))
+				return false;
+
+			clipNode.curves.push_back(clipCurve);
+		}
+
+		clipNode.channels.reserve(node.numChannels);
+		for (uint32_t k = node.firstChannel; k < node.firstChannel + node.numChannels; k++)
+		{
+			const BinaryClipChannel &channel = channels[k];
+			if (channel.attr >= footer->stringTableSize || !(channel.step > 0))
+			{
+				error = "Corrupted binary clip";
+				return false;
+			}
+
+			ClipChannel clipChannel;
+			clipChannel.attr = strings + channel.attr;
+			clipChannel.attrId = addName(channel.attr);
+			clipChannel.data.unit = channel.unit;
+			clipChannel.data.start = channel.start;
+			clipChannel.data.step = channel.step;
+
+			if (!keysReader.readChannel(channel, clipChannel.data, error))
+				return false;
+
+			clipNode.channels.push_back(clipChannel);
+		}
+
+		clipNode.statics.reserve(node.numStatics);
+		for (uint32_t k = node.firstStatic; k < node.firstStatic + node.numStatics; k++)
+		{
+			if (statics[k].attr >= footer->stringTableSize)
+			{
+				error = "Corrupted binary clip";
+				return false;
+			}
+
+			clipNode.statics.push_back({ strings + statics[k].attr, addName(statics[k].attr), statics[k].value });
+		}
+	}
+
+	return true;
+}
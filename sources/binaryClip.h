@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstring>
+
+#include "clip.h"
+
+/*
+Binary clip layout, little-endian. All tables and key columns are 8 byte aligned, so a mapped file is read in place.
+
+	BinaryClipHeader
+	per curve: times double[numKeys], values double[numKeys], inTangentTypes uint8[numKeys], outTangentTypes uint8[numKeys], padding, FixedTangent[numFixedTangents]
+	per quantized curve: BinaryQuantizedKeys, times, values, inTangentTypes uint8[numKeys], outTangentTypes uint8[numKeys], padding, FixedTangent[numFixedTangents]
+	per channel: values double[numValues]
+	per quantized channel: BinaryQuantizedKeys, values
+	per stored curve or channel: BinaryStoredKeys
+	string table: null terminated node and attribute names
+	BinaryClipNode[nodeCount]
+	BinaryClipCurve[curveCount]
+	BinaryClipChannel[channelCount]
+	BinaryClipStatic[staticCount]
+	BinaryClipFooter
+
+Tables are written after the key data, so the file is streamed in a single pass.
+
+Quantized times are integer ticks of 1/ticksPerFrame frame, quantized values are integer steps of valueQuantum from valueOrigin.
+Both are stored as differences to the previous key, zigzag varint encoded. A column which cannot be quantized exactly
+enough is stored as doubles, then ticksPerFrame or valueQuantum is zero.
+
+Curves and channels with identical keys share them, their records point to the same offset. With a curve store the keys
+are kept in a file per unique content in the store directory instead, named by the content hash, so clips of a library
+share them too. A relative store directory is relative to the clip.
+*/
+
+const char BinaryClipMagic[8] = { 'A', 'N', 'I', 'M', 'C', 'L', 'P', 'B' };
+const uint32_t BinaryClipVersion = 4; // 2 added baked channels, 3 added quantized keys, 4 added stored keys
+
+const uint8_t BinaryRawEncoding = 0;
+const uint8_t BinaryQuantizedEncoding = 1;
+const uint8_t BinaryStoredEncoding = 2;
+
+const string BinaryStoreExtension = ".animkeys";
+
+// 128 bit hash of the keys of a curve or channel
+struct ContentHash
+{
+	uint64_t low;
+	uint64_t high;
+
+	bool operator==(const ContentHash &other) const { return low == other.low && high == other.high; }
+};
+
+ContentHash hashContent(const void *data, size_t size, uint64_t seed = 0);
+
+// 32 hex digits
+string toString(const ContentHash &hash);
+
+struct BinaryClipHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+};
+
+struct BinaryClipNode
+{
+	uint32_t name; // offset in the string table
+	uint32_t firstCurve;
+	uint32_t numCurves;
+	uint32_t firstStatic;
+	uint32_t numStatics;
+	uint32_t firstChannel;
+	uint32_t numChannels;
+	uint32_t padding;
+};
+
+struct BinaryClipCurve
+{
+	uint32_t attr;
+	uint8_t weighted;
+	uint8_t preInfinity;
+	uint8_t postInfinity;
+	uint8_t encoding;
+	int32_t unit;
+	uint32_t numKeys;
+	uint32_t numFixedTangents;
+	uint32_t padding2;
+	uint64_t keysOffset;
+};
+
+struct BinaryClipChannel
+{
+	uint32_t attr;
+	int32_t unit;
+	uint32_t numValues;
+	uint8_t encoding;
+	uint8_t padding[3];
+	double start;
+	double step;
+	uint64_t valuesOffset;
+};
+
+struct BinaryQuantizedKeys
+{
+	double valueOrigin;
+	double valueQuantum; // twice the tolerance, zero when values are stored as doubles
+	uint32_t ticksPerFrame; // zero when times are stored as doubles
+	uint32_t timesSize; // bytes
+	uint32_t valuesSize;
+	uint32_t padding;
+};
+
+// keys kept in the curve store
+struct BinaryStoredKeys
+{
+	ContentHash hash;
+	uint64_t size; // of the store file
+	uint32_t store; // string table offset of the store directory
+	uint8_t encoding; // of the keys in the store file
+	uint8_t padding[3];
+};
+
+struct BinaryClipStatic
+{
+	uint32_t attr;
+	uint32_t padding;
+	double value;
+};
+
+struct BinaryClipFooter
+{
+	uint64_t stringTableOffset;
+	uint64_t stringTableSize;
+	uint64_t nodeTableOffset;
+	uint64_t curveTableOffset;
+	uint64_t staticTableOffset;
+	uint64_t channelTableOffset;
+	uint32_t nodeCount;
+	uint32_t curveCount;
+	uint32_t staticCount;
+	uint32_t channelCount;
+	char magic[8];
+};
+
+static_assert(sizeof(FixedTangent) == 72, "FixedTangent layout is part of the binary clip format");
+static_assert(sizeof(BinaryClipHeader) == 16, "unexpected BinaryClipHeader size");
+static_assert(sizeof(BinaryClipNode) == 32, "unexpected BinaryClipNode size");
+static_assert(sizeof(BinaryClipCurve) == 32, "unexpected BinaryClipCurve size");
+static_assert(sizeof(BinaryClipChannel) == 40, "unexpected BinaryClipChannel size");
+static_assert(sizeof(BinaryQuantizedKeys) == 32, "unexpected BinaryQuantizedKeys size");
+static_assert(sizeof(BinaryStoredKeys) == 32, "unexpected BinaryStoredKeys size");
+static_assert(sizeof(BinaryClipStatic) == 16, "unexpected BinaryClipStatic size");
+static_assert(sizeof(BinaryClipFooter) == 72, "unexpected BinaryClipFooter size");
+
+inline bool isBinaryClip(const char *data, size_t size)
+{
+	return size >= sizeof(BinaryClipHeader) && memcmp(data, BinaryClipMagic, sizeof(BinaryClipMagic)) == 0;
+}
+
+// Makes views to nodes, curves, channels and statics of the clip's mapped file and curve store files, quantized keys are decoded once into the clip
+bool readBinaryClip(Clip &clip, string &error, const ClipNodeFilter &filter = nullptr);
+
+class BinaryClipWriter : public ClipWriter
+{
+public:
+	BinaryClipWriter();
+	~BinaryClipWriter();
+
+	bool open(const char *filePath) override;
+
+	void beginNode(const char *name) override;
+	void writeCurve(const char *attr, const CurveData &curve) override;
+	void writeChannel(const char *attr, const ChannelData &channel) override;
+	void writeStatic(const char *attr, double value) override;
+	void endNode() override;
+
+	bool close() override;
+
+	void setCurveStore(const string &directory) override { m_store = directory; }
+
+	// files this writer added to the curve store
+	const vector<string>& storedFiles() const { return m_storedFiles; }
+
+private:
+	struct WrittenKeys
+	{
+		uint64_t offset;
+		uint8_t encoding;
+		size_t size;
+		size_t bytesOffset; // in m_writtenBytes
+	};
+
+	struct ContentHashHasher
+	{
+		size_t operator()(const ContentHash &hash) const { return (size_t)hash.low; }
+	};
+
+	void write(const void *data, size_t size);
+	void align();
+	uint32_t addString(const char *str);
+	void appendQuantized(const double *times, const double *values, size_t numValues, double tolerance);
+	uint64_t writeKeys(uint8_t &encoding);
+	bool storeKeys(const ContentHash &hash);
+	bool isWritten(const WrittenKeys &written) const;
+
+	StringTable m_strings;
+
+	vector<BinaryClipNode> m_nodes;
+	vector<BinaryClipCurve> m_curves;
+	vector<BinaryClipChannel> m_channels;
+	vector<BinaryClipStatic> m_statics;
+
+	string m_times; // quantized columns of the current curve
+	string m_values;
+	string m_keys; // keys of the current curve or channel as laid out in the file
+
+	// keys are reused only when their bytes match, a hash shared by different keys gets several entries
+	unordered_multimap<ContentHash, WrittenKeys, ContentHashHasher> m_writtenKeys;
+	string m_writtenBytes; // every unique key encoding written, as large as the uncompressed key data of the clip
+	uint32_t m_numTempFiles;
+
+	string m_store;
+	string m_storePath; // resolved against the clip directory
+	uint32_t m_storeString;
+	vector<string> m_storedFiles;
+};
@@ -0,0 +1,101 @@
+#include "blockFile.h"
+#include "lz4Block.h"
+#include "parallel.h"
+
+// enough data for the threads to be worth starting
+const size_t MinParallelSize = 4 * BlockFileBlockSize;
+
+void compressBlocks(const char *data, size_t size, vector<string> &blocks)
+{
+	blocks.resize((size + BlockFileBlockSize - 1) / BlockFileBlockSize);
+
+	parallelFor(blocks.size(), getNumThreads(blocks.size(), size, MinParallelSize), [&](size_t i)
+	{
+		const size_t offset = i * BlockFileBlockSize;
+		const size_t blockSize = min(BlockFileBlockSize, size - offset);
+
+		string &block = blocks[i];
+		block.resize(blockSize);
+
+		const size_t compressedSize = blockSize > 0 ? lz4Compress(data + offset, blockSize, &block[0], blockSize - 1) : 0;
+		block.resize(compressedSize);
+	});
+}
+
+static bool isInside(uint64_t offset, uint64_t size, size_t fileSize)
+{
+	return offset <= fileSize && size <= fileSize - offset;
+}
+
+bool decompressBlockFile(const char *data, size_t size, unique_ptr<char[]> &output, size_t &outputSize, string &error)
+{
+	if (!isBlockFile(data, size) || size < sizeof(BlockFileHeader) + sizeof(BlockFileFooter))
+	{
+		error = "Not a compressed clip";
+		return false;
+	}
+
+	const BlockFileHeader *header = (const BlockFileHeader*)data;
+	if (header->version != BlockFileVersion)
+	{
+		error = "Unsupported compressed clip version " + to_string(header->version);
+		return false;
+	}
+
+	const BlockFileFooter *footer = (const BlockFileFooter*)(data + size - sizeof(BlockFileFooter));
+	if (memcmp(footer->magic, BlockFileMagic, sizeof(BlockFileMagic)) != 0 ||
+		!isInside(footer->blockTableOffset, (uint64_t)footer->blockCount * sizeof(BlockFileBlock), size) ||
+		footer->size > (uint64_t)footer->blockCount * header->blockSize)
+	{
+		error = "Corrupted compressed clip";
+		return false;
+	}
+
+	const BlockFileBlock *blocks = (const BlockFileBlock*)(data + footer->blockTableOffset);
+
+	// blocks are contiguous in the decompressed data, their offsets there follow from the sizes
+	vector<uint64_t> offsets(footer->blockCount);
+	uint64_t offset = 0;
+	for (uint32_t i = 0; i < footer->blockCount; i++)
+	{
+		const BlockFileBlock &block = blocks[i];
+		if (!isInside(block.offset, block.compressedSize, size) || block.size > header->blockSize || block.compressedSize > block.size)
+		{
+			error = "Corrupted compressed clip";
+			return false;
+		}
+
+		offsets[i] = offset;
+		offset += block.size;
+	}
+
+	if (offset != footer->size)
+	{
+		error = "Corrupted compressed clip";
+		return false;
+	}
+
+	outputSize = (size_t)footer->size;
+	output.reset(new char[outputSize + 1]);
+
+	atomic<bool> ok(true);
+	parallelFor(footer->blockCount, getNumThreads(footer->blockCount, outputSize, MinParallelSize), [&](size_t i)
+	{
+		const BlockFileBlock &block = blocks[i];
+		char *dst = output.get() + offsets[i];
+
+		if (block.compressedSize == block.size)
+			memcpy(dst, data + block.offset, block.size);
+		else if (!lz4Decompress(data + block.offset, block.compressedSize, dst, block.size))
+			ok = false;
+	});
+
+	if (!ok)
+	{
+		output.reset();
+		error = "Corrupted compressed clip";
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+Block compressed container of a clip file, little-endian.
+
+	BlockFileHeader
+	per block: LZ4 compressed data, or the raw data when it does not compress
+	BlockFileBlock[blockCount]
+	BlockFileFooter
+
+Blocks are compressed independently, so they are compressed and decompressed by several threads at once.
+The decompressed data is a json or binary clip file.
+*/
+
+const char BlockFileMagic[8] = { 'A', 'N', 'I', 'M', 'C', 'L', 'P', 'Z' };
+const uint32_t BlockFileVersion = 1;
+const size_t BlockFileBlockSize = 256 * 1024;
+
+struct BlockFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t blockSize;
+};
+
+struct BlockFileBlock
+{
+	uint64_t offset;
+	uint32_t compressedSize; // equal to size when the block is stored raw
+	uint32_t size;
+};
+
+struct BlockFileFooter
+{
+	uint64_t blockTableOffset;
+	uint64_t size; // of the decompressed data
+	uint32_t blockCount;
+	uint32_t padding;
+	char magic[8];
+};
+
+static_assert(sizeof(BlockFileHeader) == 16, "unexpected BlockFileHeader size");
+static_assert(sizeof(BlockFileBlock) == 16, "unexpected BlockFileBlock size");
+static_assert(sizeof(BlockFileFooter) == 32, "unexpected BlockFileFooter size");
+
+inline bool isBlockFile(const char *data, size_t size)
+{
+	return size >= sizeof(BlockFileHeader) && memcmp(data, BlockFileMagic, sizeof(BlockFileMagic)) == 0;
+}
+
+// Compresses data in blocks of BlockFileBlockSize on several threads. An empty block means the data does not compress.
+void compressBlocks(const char *data, size_t size, vector<string> &blocks);
+
+// decompresses all blocks of a block file into one buffer on several threads
+bool decompressBlockFile(const char *data, size_t size, unique_ptr<char[]> &output, size_t &outputSize, string &error);
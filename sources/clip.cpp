@@ -0,0 +1,176 @@
+#include <cstring>
+
+#include "clip.h"
+#include "jsonClip.h"
+#include "binaryClip.h"
+#include "blockFile.h"
+
+ClipFormat getClipFormat(const string &filePath)
+{
+	const size_t n = BinaryClipExtension.size();
+	return filePath.size() >= n && filePath.compare(filePath.size() - n, n, BinaryClipExtension) == 0 ? BinaryClipFormat : JsonClipFormat;
+}
+
+// ids of the table are the tangent types
+int findTangentType(const char *name, size_t length)
+{
+	static const StringTable tangentTypes(TangentTypes);
+
+	const uint32_t type = tangentTypes.find(name, length);
+	return type != StringTable::NotFound ? (int)type : -1;
+}
+
+void getChannelCurveData(const ChannelData &channel, CurveKeys &keys, CurveData &curve)
+{
+	keys.clear();
+	keys.times.resize(channel.numValues);
+	for (size_t i = 0; i < channel.numValues; i++)
+		keys.times[i] = channel.start + i * channel.step;
+
+	keys.inTangentTypes.assign(channel.numValues, TangentLinear);
+	keys.outTangentTypes.assign(channel.numValues, TangentLinear);
+
+	curve = CurveData();
+	curve.unit = channel.unit;
+	curve.setKeys(keys);
+	curve.values = channel.values; // used in place
+}
+
+unique_ptr<ClipWriter> createClipWriter(ClipFormat format)
+{
+	if (format == BinaryClipFormat)
+		return unique_ptr<ClipWriter>(new BinaryClipWriter());
+
+	return unique_ptr<ClipWriter>(new JsonClipWriter());
+}
+
+bool Clip::load(const char *filePath, string &error, Profiler *profiler, const ClipNodeFilter &filter)
+{
+	Profiler noProfiler;
+	Profiler &prof = profiler ? *profiler : noProfiler;
+
+	m_filePath = filePath;
+
+	{
+		Profiler::Scope scope(prof, "io");
+		if (!m_file.open(filePath, true)) // json is parsed in place
+		{
+			error = "Cannot open file '" + string(filePath) + "'";
+			return false;
+		}
+	}
+
+	prof.addCount("bytes", m_file.size());
+
+	if (isBlockFile(m_file.data(), m_file.size()))
+	{
+		Profiler::Scope scope(prof, "decompression");
+
+		unique_ptr<char[]> data;
+		size_t size = 0;
+		if (!decompressBlockFile(m_file.data(), m_file.size(), data, size, error))
+		{
+			error = "Cannot read clip '" + string(filePath) + "': " + error;
+			return false;
+		}
+
+		m_file.assign(move(data), size);
+	}
+
+	// rejected nodes are remembered, so users of a filtered clip kept in a cache still know about them
+	m_skippedNodes.clear();
+	ClipNodeFilter skippingFilter;
+	if (filter)
+	{
+		skippingFilter = [&](const char *name)
+		{
+			if (filter(name))
+				return true;
+
+			m_skippedNodes.push_back(name);
+			return false;
+		};
+	}
+
+	bool ok;
+	if (isBinaryClip(m_file.data(), m_file.size()))
+	{
+		Profiler::Scope scope(prof, "parse");
+		ok = readBinaryClip(*this, error, skippingFilter);
+	}
+	else
+		ok = readJsonClip(*this, error, &prof, skippingFilter);
+
+	if (!ok)
+		error = "Cannot read clip '" + string(filePath) + "': " + error;
+
+	return ok;
+}
+
+const ClipNode* Clip::findNode(const string &name) const
+{
+	const uint32_t id = m_names.find(name.c_str(), name.size());
+	return id < m_nodeIndices.size() && m_nodeIndices[id] != UINT32_MAX ? &m_nodes[m_nodeIndices[id]] : nullptr;
+}
+
+size_t Clip::memorySize() const
+{
+	size_t size = sizeof(Clip) + m_file.size();
+
+	for (const auto &file : m_files)
+		size += sizeof(MappedFile) + file.size();
+
+	size += m_names.memorySize() + m_nodeIndices.capacity() * sizeof(uint32_t);
+
+	for (const auto &keys : m_keys)
+	{
+		size += sizeof(CurveKeys) + (keys.times.capacity() + keys.values.capacity()) * sizeof(double) +
+			keys.inTangentTypes.capacity() + keys.outTangentTypes.capacity() + keys.fixedTangents.capacity() * sizeof(FixedTangent);
+	}
+
+	for (const auto &values : m_values)
+		size += sizeof(vector<double>) + values.capacity() * sizeof(double);
+
+	size += m_nodes.capacity() * sizeof(ClipNode);
+	for (const auto &node : m_nodes)
+		size += node.curves.capacity() * sizeof(ClipCurve) + node.channels.capacity() * sizeof(ClipChannel) + node.statics.capacity() * sizeof(ClipStatic);
+
+	return size;
+}
+
+// the first node of a name is found
+ClipNode& Clip::addNode(uint32_t nameId)
+{
+	if (nameId >= m_nodeIndices.size())
+		m_nodeIndices.resize(nameId + 1, UINT32_MAX);
+	if (m_nodeIndices[nameId] == UINT32_MAX)
+		m_nodeIndices[nameId] = (uint32_t)m_nodes.size();
+
+	m_nodes.push_back(ClipNode());
+	m_nodes.back().name = m_names.get(nameId);
+	m_nodes.back().nameId = nameId;
+	return m_nodes.back();
+}
+
+uint32_t Clip::addName(const char *str, size_t length, bool copy)
+{
+	return m_names.intern(str, length, copy);
+}
+
+CurveKeys& Clip::addKeys()
+{
+	m_keys.push_back(CurveKeys());
+	return m_keys.back();
+}
+
+vector<double>& Clip::addValues()
+{
+	m_values.push_back(vector<double>());
+	return m_values.back();
+}
+
+MappedFile& Clip::addFile()
+{
+	m_files.emplace_back();
+	return m_files.back();
+}
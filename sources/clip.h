@@ -0,0 +1,263 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+
+#include "mappedFile.h"
+#include "outputFile.h"
+#include "profiler.h"
+#include "stringTable.h"
+
+using namespace std;
+
+// in the order of MFnAnimCurve::AnimCurveType and MFnAnimCurve::TangentType
+const vector<string> AnimCurveTypes{ "animCurveTA", "animCurveTL", "animCurveTT", "animCurveTU", "animCurveUA", "animCurveUL", "animCurveUT", "animCurveUU" };
+const vector<string> TangentTypes{ "global", "fixed", "linear", "flat", "spline", "step", "slow", "fast", "clamped", "plateau", "stepnext", "auto" };
+
+const uint8_t TangentFixed = 1;
+const uint8_t TangentLinear = 2;
+const uint8_t TangentFlat = 3;
+const uint8_t TangentSpline = 4;
+const uint8_t TangentStep = 5;
+const uint8_t TangentClamped = 8;
+const uint8_t TangentPlateau = 9;
+const uint8_t TangentStepNext = 10;
+const uint8_t TangentAuto = 11;
+
+// in the order of MFnAnimCurve::InfinityType
+const int InfinityConstant = 0;
+const int InfinityLinear = 1;
+const int InfinityCycle = 3;
+const int InfinityCycleRelative = 4;
+const int InfinityOscillate = 5;
+
+// values of angular curves are stored in degrees
+const double RadiansToDegrees = 180.0 / 3.14159265358979323846;
+const double DegreesToRadians = 3.14159265358979323846 / 180.0;
+
+inline bool isAngularCurveType(int animCurveType) { return animCurveType == 0 || animCurveType == 4; } // animCurveTA, animCurveUA
+
+// maximum value error allowed per kind of curve output, zero keeps the values exact
+struct CurveTolerances
+{
+	double angular = 0; // degrees, animCurveTA and animCurveUA
+	double linear = 0; // animCurveTL and animCurveUL
+	double unitless = 0; // animCurveTU, animCurveUU and time output curves
+
+	bool isEnabled() const { return angular > 0 || linear > 0 || unitless > 0; }
+	double get(int animCurveType) const { return isAngularCurveType(animCurveType) ? angular : animCurveType == 1 || animCurveType == 5 ? linear : unitless; }
+};
+
+enum ClipFormat { JsonClipFormat, BinaryClipFormat };
+
+const string BinaryClipExtension = ".animclipb";
+
+// binary clips are chosen by the file extension, everything else is json
+ClipFormat getClipFormat(const string &filePath);
+
+int findTangentType(const char *name, size_t length);
+inline int findTangentType(const char *name) { return findTangentType(name, strlen(name)); }
+
+// tangents of a key which has fixed in or out tangent type
+struct FixedTangent
+{
+	uint32_t key; // index of the key in the curve
+	uint8_t weightsLocked;
+	uint8_t tangentsLocked;
+	uint8_t padding[2];
+
+	double inAngle; // radians
+	double outAngle;
+	double inWeight;
+	double outWeight;
+
+	// used by weighted curves only
+	double inX;
+	double inY;
+	double outX;
+	double outY;
+};
+
+// keys of a curve stored as columns, reused between curves to avoid per key allocations
+struct CurveKeys
+{
+	vector<double> times;
+	vector<double> values;
+	vector<uint8_t> inTangentTypes;
+	vector<uint8_t> outTangentTypes;
+	vector<FixedTangent> fixedTangents; // sorted by key
+
+	size_t size() const { return times.size(); }
+
+	void clear()
+	{
+		times.clear();
+		values.clear();
+		inTangentTypes.clear();
+		outTangentTypes.clear();
+		fixedTangents.clear();
+	}
+};
+
+// curve settings and pointers to its key columns
+struct CurveData
+{
+	bool weighted = false;
+	int preInfinity = 0;
+	int postInfinity = 0;
+	int unit = 0;
+
+	size_t numKeys = 0;
+	const double *times = nullptr;
+	const double *values = nullptr; // degrees for angular curves
+	const uint8_t *inTangentTypes = nullptr;
+	const uint8_t *outTangentTypes = nullptr;
+
+	size_t numFixedTangents = 0;
+	const FixedTangent *fixedTangents = nullptr;
+
+	double tolerance = 0; // value error allowed when stored, binary clips quantize the values within it
+
+	void setKeys(const CurveKeys &keys)
+	{
+		numKeys = keys.size();
+		times = keys.times.data();
+		values = keys.values.data();
+		inTangentTypes = keys.inTangentTypes.data();
+		outTangentTypes = keys.outTangentTypes.data();
+		numFixedTangents = keys.fixedTangents.size();
+		fixedTangents = keys.fixedTangents.data();
+	}
+};
+
+// values sampled at a uniform rate, written by baked exports instead of keys
+struct ChannelData
+{
+	int unit = 0;
+	double start = 0; // time of the first value, relative to the clip start
+	double step = 1;
+
+	size_t numValues = 0;
+	const double *values = nullptr; // degrees for angular channels
+
+	double tolerance = 0; // value error allowed when stored
+};
+
+// builds linear keys at the channel sample times, the channel values are used in place
+void getChannelCurveData(const ChannelData &channel, CurveKeys &keys, CurveData &curve);
+
+// Receives a clip node by node. Curves of a node must be written before its channels, and channels before its static values.
+class ClipWriter
+{
+public:
+	virtual ~ClipWriter() {}
+
+	virtual bool open(const char *filePath) = 0;
+
+	virtual void beginNode(const char *name) = 0;
+	virtual void writeCurve(const char *attr, const CurveData &curve) = 0;
+	virtual void writeChannel(const char *attr, const ChannelData &channel) = 0;
+	virtual void writeStatic(const char *attr, double value) = 0;
+	virtual void endNode() = 0;
+
+	virtual bool close() = 0;
+
+	// the file being written is removed, the file it would replace is kept
+	void discard() { m_output.discard(); }
+
+	// files opened afterwards are block compressed
+	void setCompressed(bool compressed) { m_output.setCompressed(compressed); }
+
+	// binary clips opened afterwards keep the keys of their curves in the store directory, json clips ignore it
+	virtual void setCurveStore(const string &/*directory*/) {}
+
+	const OutputFile& output() const { return m_output; }
+
+protected:
+	OutputFile m_output;
+};
+
+// names are interned by the clip, equal names have equal ids
+struct ClipCurve
+{
+	const char *attr;
+	uint32_t attrId;
+	CurveData data;
+};
+
+struct ClipChannel
+{
+	const char *attr;
+	uint32_t attrId;
+	ChannelData data;
+};
+
+struct ClipStatic
+{
+	const char *attr;
+	uint32_t attrId;
+	double value;
+};
+
+struct ClipNode
+{
+	const char *name;
+	uint32_t nameId;
+	vector<ClipCurve> curves;
+	vector<ClipChannel> channels;
+	vector<ClipStatic> statics;
+};
+
+// selects clip nodes to load by name
+typedef function<bool(const char *name)> ClipNodeFilter;
+
+// Clip loaded from a mapped file. Binary clips are read in place, json clips are parsed in place and decoded into owned key columns.
+class Clip
+{
+public:
+	Clip() {}
+	Clip(const Clip&) = delete;
+	Clip& operator=(const Clip&) = delete;
+
+	// only nodes accepted by the filter are loaded, all of them without a filter
+	bool load(const char *filePath, string &error, Profiler *profiler = nullptr, const ClipNodeFilter &filter = nullptr);
+
+	const string& filePath() const { return m_filePath; }
+	const vector<ClipNode>& nodes() const { return m_nodes; }
+	const vector<string>& skippedNodes() const { return m_skippedNodes; } // names of the nodes the filter rejected
+	const ClipNode* findNode(const string &name) const;
+
+	// node and attribute names, ids index per name data of the users of the clip
+	const StringTable& names() const { return m_names; }
+
+	// approximate memory held by the clip, including its mapped file
+	size_t memorySize() const;
+
+	// used by the readers to fill the clip
+	ClipNode& addNode(uint32_t nameId);
+	uint32_t addName(const char *str, size_t length, bool copy = true); // names in the clip's file are not copied
+	CurveKeys& addKeys();
+	vector<double>& addValues();
+	MappedFile& addFile();
+	MappedFile& file() { return m_file; }
+
+private:
+	string m_filePath;
+	MappedFile m_file;
+	deque<MappedFile> m_files; // curve store files
+	StringTable m_names;
+	deque<CurveKeys> m_keys;
+	deque<vector<double>> m_values;
+
+	vector<ClipNode> m_nodes;
+	vector<string> m_skippedNodes;
+	vector<uint32_t> m_nodeIndices; // per name id
+};
+
+unique_ptr<ClipWriter> createClipWriter(ClipFormat format);
@@ -0,0 +1,260 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/prettywriter.h"
+
+#include "clipCache.h"
+
+using namespace rapidjson;
+
+#ifdef _WIN32
+
+bool getFileStamp(const char *filePath, FileStamp &stamp)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(filePath, GetFileExInfoStandard, &data))
+		return false;
+
+	stamp.size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	stamp.modificationTime = ((int64_t)data.ftLastWriteTime.dwHighDateTime << 32 | data.ftLastWriteTime.dwLowDateTime) * 100;
+	return true;
+}
+
+#else
+
+bool getFileStamp(const char *filePath, FileStamp &stamp)
+{
+	struct stat st;
+	if (stat(filePath, &st) != 0)
+		return false;
+
+	stamp.size = (uint64_t)st.st_size;
+#ifdef __APPLE__
+	stamp.modificationTime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+	stamp.modificationTime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+	return true;
+}
+
+#endif
+
+shared_ptr<const Clip> ClipCache::load(const char *filePath, string &error, Profiler *profiler, const ClipNodeFilter &filter, const string &filterKey)
+{
+	Profiler noProfiler;
+	Profiler &prof = profiler ? *profiler : noProfiler;
+
+	FileStamp stamp;
+	if (!getFileStamp(filePath, stamp))
+	{
+		error = "Cannot open file '" + string(filePath) + "'";
+		return nullptr;
+	}
+
+	const bool isFiltered = filter != nullptr;
+	bool cacheable;
+	{
+		lock_guard<mutex> lock(m_mutex);
+
+		const Entry *found = findEntry(filePath, filterKey, stamp);
+		if (found)
+		{
+			const auto entry = m_index[found->key];
+			m_entries.splice(m_entries.begin(), m_entries, entry);
+			entry->hits++;
+			m_hits++;
+			prof.addCount("cacheHits", 1);
+			return entry->clip;
+		}
+
+		removeEntries(filePath, &stamp); // the file has changed
+
+		m_misses++;
+		prof.addCount("cacheMisses", 1);
+
+		// a whole clip larger than the budget would be evicted at once, a filtered one may be much smaller than its file
+		cacheable = isFiltered ? !filterKey.empty() : stamp.size <= m_budget;
+	}
+
+	shared_ptr<Clip> clip = make_shared<Clip>();
+	if (!clip->load(filePath, error, profiler, filter))
+		return nullptr;
+
+	const size_t memorySize = clip->memorySize();
+
+	lock_guard<mutex> lock(m_mutex);
+	if (!cacheable || memorySize > m_budget)
+		return clip;
+
+	Entry entry;
+	entry.key = getKey(filePath, isFiltered ? filterKey : string());
+	entry.filePath = filePath;
+	entry.isFiltered = isFiltered;
+	entry.stamp = stamp;
+	entry.clip = clip;
+	entry.memorySize = memorySize;
+	entry.hits = 0;
+
+	removeEntry(entry.key); // loaded by another thread meanwhile
+
+	m_entries.push_front(entry);
+	m_index[entry.key] = m_entries.begin();
+	m_memorySize += memorySize;
+
+	evict();
+	return clip;
+}
+
+const ClipCache::Entry* ClipCache::findEntry(const string &filePath, const string &filterKey, const FileStamp &stamp) const
+{
+	for (const string &key : { getKey(filePath, filterKey), filePath })
+	{
+		const auto found = m_index.find(key);
+		if (found != m_index.end() && found->second->stamp == stamp)
+			return &*found->second;
+	}
+	return nullptr;
+}
+
+shared_ptr<const Clip> ClipCache::find(const char *filePath, const string &filterKey) const
+{
+	FileStamp stamp;
+	if (!getFileStamp(filePath, stamp))
+		return nullptr;
+
+	lock_guard<mutex> lock(m_mutex);
+
+	const Entry *found = findEntry(filePath, filterKey, stamp);
+	return found ? found->clip : nullptr;
+}
+
+void ClipCache::setBudget(size_t budget)
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_budget = budget;
+	evict();
+}
+
+size_t ClipCache::budget() const
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_budget;
+}
+
+size_t ClipCache::memorySize() const
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_memorySize;
+}
+
+uint64_t ClipCache::hits() const
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_hits;
+}
+
+uint64_t ClipCache::misses() const
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_misses;
+}
+
+void ClipCache::clear()
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_entries.clear();
+	m_index.clear();
+	m_memorySize = 0;
+}
+
+void ClipCache::remove(const string &filePath)
+{
+	lock_guard<mutex> lock(m_mutex);
+	removeEntries(filePath);
+}
+
+void ClipCache::removeEntries(const string &filePath, const FileStamp *keptStamp)
+{
+	for (auto entry = m_entries.begin(); entry != m_entries.end();)
+	{
+		const auto next = std::next(entry);
+		if (entry->filePath == filePath && (!keptStamp || entry->stamp != *keptStamp))
+			removeEntry(entry->key);
+		entry = next;
+	}
+}
+
+void ClipCache::removeEntry(const string &key)
+{
+	const auto found = m_index.find(key);
+	if (found == m_index.end())
+		return;
+
+	m_memorySize -= found->second->memorySize;
+	m_entries.erase(found->second);
+	m_index.erase(found);
+}
+
+// clips in use stay alive through their shared pointers after eviction
+void ClipCache::evict()
+{
+	while (m_memorySize > m_budget && !m_entries.empty())
+		removeEntry(m_entries.back().key);
+}
+
+vector<ClipCache::EntryInfo> ClipCache::entries() const
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	vector<EntryInfo> infos;
+	infos.reserve(m_entries.size());
+
+	for (const auto &entry : m_entries)
+		infos.push_back({ entry.filePath, entry.isFiltered, entry.memorySize, entry.hits });
+
+	return infos;
+}
+
+string ClipCache::toJson() const
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	StringBuffer buffer;
+	PrettyWriter<StringBuffer> writer(buffer);
+
+	writer.StartObject();
+	writer.Key("budget");
+	writer.Uint64(m_budget);
+	writer.Key("memorySize");
+	writer.Uint64(m_memorySize);
+	writer.Key("hits");
+	writer.Uint64(m_hits);
+	writer.Key("misses");
+	writer.Uint64(m_misses);
+
+	writer.Key("clips");
+	writer.StartArray();
+	for (const auto &entry : m_entries)
+	{
+		writer.StartObject();
+		writer.Key("file");
+		writer.String(entry.filePath.c_str(), (SizeType)entry.filePath.size());
+		writer.Key("filtered");
+		writer.Bool(entry.isFiltered);
+		writer.Key("memorySize");
+		writer.Uint64(entry.memorySize);
+		writer.Key("hits");
+		writer.Uint64(entry.hits);
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	writer.EndObject();
+	return buffer.GetString();
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+
+#include "clip.h"
+
+using namespace std;
+
+const size_t DefaultClipCacheBudget = 256 * 1024 * 1024;
+
+// size and modification time of a file, a cached clip is reused only while both match
+struct FileStamp
+{
+	uint64_t size = 0;
+	int64_t modificationTime = 0; // nanoseconds
+
+	bool operator==(const FileStamp &other) const { return size == other.size && modificationTime == other.modificationTime; }
+	bool operator!=(const FileStamp &other) const { return !(*this == other); }
+};
+
+bool getFileStamp(const char *filePath, FileStamp &stamp);
+
+// Decoded clips kept in memory by path and filter. Least recently used clips are evicted when the memory budget is exceeded.
+// Safe to use from several threads, players load clips from evaluation threads.
+// A filtered clip is kept under a key naming the nodes its filter accepts, a whole clip of the file serves any filter.
+class ClipCache
+{
+public:
+	struct EntryInfo
+	{
+		string filePath;
+		bool isFiltered;
+		size_t memorySize;
+		uint64_t hits;
+	};
+
+	ClipCache(size_t budget = DefaultClipCacheBudget) : m_budget(budget), m_memorySize(0), m_hits(0), m_misses(0) {}
+
+	ClipCache(const ClipCache&) = delete;
+	ClipCache& operator=(const ClipCache&) = delete;
+
+	// Returns the cached clip while its file is unchanged. Otherwise loads the clip with the filter and caches it if it fits
+	// the budget. A filter without a key is applied but its clip is not cached.
+	shared_ptr<const Clip> load(const char *filePath, string &error, Profiler *profiler = nullptr, const ClipNodeFilter &filter = nullptr,
+		const string &filterKey = string());
+
+	// the cached clip while its file is unchanged, null otherwise, never loads
+	shared_ptr<const Clip> find(const char *filePath, const string &filterKey = string()) const;
+
+	void setBudget(size_t budget);
+	size_t budget() const;
+	size_t memorySize() const;
+
+	uint64_t hits() const;
+	uint64_t misses() const;
+
+	void clear();
+	void remove(const string &filePath); // with all of its filtered clips
+
+	// most recently used first
+	vector<EntryInfo> entries() const;
+
+	string toJson() const;
+
+private:
+	struct Entry
+	{
+		string key; // file path and filter key
+		string filePath;
+		bool isFiltered;
+		FileStamp stamp;
+		shared_ptr<const Clip> clip;
+		size_t memorySize;
+		uint64_t hits;
+	};
+
+	static string getKey(const string &filePath, const string &filterKey) { return filterKey.empty() ? filePath : filePath + "\n" + filterKey; }
+
+	// the entry of the filter, or of the whole clip, while the file is unchanged
+	const Entry* findEntry(const string &filePath, const string &filterKey, const FileStamp &stamp) const;
+	void removeEntry(const string &key);
+	void removeEntries(const string &filePath, const FileStamp *keptStamp = nullptr); // entries of the stamp are kept
+	void evict();
+
+	mutable mutex m_mutex; // the clip itself is loaded unlocked, so one load does not wait for another
+	size_t m_budget;
+	size_t m_memorySize;
+	uint64_t m_hits;
+	uint64_t m_misses;
+
+	list<Entry> m_entries; // most recently used first
+	unordered_map<string, list<Entry>::iterator> m_index; // by key
+};
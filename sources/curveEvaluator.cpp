@@ -0,0 +1,314 @@
+#include <cmath>
+#include <algorithm>
+
+#include "curveEvaluator.h"
+#include "parallel.h"
+
+// time error of weighted segments, relative to the segment
+const double BezierTolerance = 1e-12;
+const int MaxBezierIterations = 64;
+
+const size_t MinParallelSamples = 100000;
+
+const uint8_t SegmentCubic = 0;
+const uint8_t SegmentStepNext = 1;
+const uint8_t SegmentBezier = 2;
+
+double getFramesPerSecond(int timeUnit)
+{
+	// MTime::Unit from kHours to k90FPS
+	static const double rates[] = { 0, 1.0 / 3600, 1.0 / 60, 1, 1000, 15, 24, 25, 30, 48, 50, 60,
+		2, 3, 4, 5, 6, 8, 10, 12, 16, 20, 40, 75, 80, 100, 120, 125, 150, 200, 240, 250, 300, 375, 400, 500, 600, 750, 1200, 1500, 2000, 3000, 6000,
+		24000.0 / 1001, 30000.0 / 1001, 30000.0 / 1001, 48000.0 / 1001, 60000.0 / 1001, 44100, 48000, 90 };
+
+	return timeUnit >= 0 && timeUnit < (int)(sizeof(rates) / sizeof(rates[0])) ? rates[timeUnit] : 0;
+}
+
+bool canEvaluate(const CurveData &curve)
+{
+	auto isKnown = [](uint8_t type)
+	{
+		return type == TangentFixed || type == TangentLinear || type == TangentFlat || type == TangentSpline ||
+			type == TangentStep || type == TangentStepNext;
+	};
+
+	for (size_t i = 0; i < curve.numKeys; i++)
+	{
+		if (!isKnown(curve.inTangentTypes[i]) || !isKnown(curve.outTangentTypes[i]))
+			return false;
+	}
+	return true;
+}
+
+// keys at the same time have no slope between them
+static double getSlope(const double *times, const double *values, size_t first, size_t second)
+{
+	const double dt = times[second] - times[first];
+	return dt > 0 ? (values[second] - values[first]) / dt : 0;
+}
+
+// slope of a key from its tangent type, on the in or the out side, fixed tangents are set by prepare
+static double getTangentSlope(const CurveData &curve, size_t i, uint8_t type, bool isIn)
+{
+	const double *t = curve.times;
+	const double *v = curve.values;
+	const size_t last = curve.numKeys - 1;
+
+	if (curve.numKeys < 2 || type == TangentFlat || type == TangentStep || type == TangentStepNext)
+		return 0;
+
+	const double inSlope = i > 0 ? getSlope(t, v, i - 1, i) : getSlope(t, v, 0, 1);
+	const double outSlope = i < last ? getSlope(t, v, i, i + 1) : getSlope(t, v, last - 1, last);
+
+	if (type == TangentLinear)
+		return isIn ? inSlope : outSlope;
+
+	// end keys continue their segment
+	return i == 0 ? outSlope : i == last ? inSlope : getSlope(t, v, i - 1, i + 1);
+}
+
+void CurveEvaluator::prepare(const CurveData &curve, bool isAngular)
+{
+	m_times.assign(curve.times, curve.times + curve.numKeys);
+	m_values.assign(curve.values, curve.values + curve.numKeys);
+	m_preInfinity = curve.preInfinity;
+	m_postInfinity = curve.postInfinity;
+	m_unit = curve.unit;
+
+	vector<Tangent> inTangents(curve.numKeys), outTangents(curve.numKeys);
+	for (size_t i = 0; i < curve.numKeys; i++)
+	{
+		inTangents[i] = { getTangentSlope(curve, i, curve.inTangentTypes[i], true), -1 };
+		outTangents[i] = { getTangentSlope(curve, i, curve.outTangentTypes[i], false), -1 };
+	}
+
+	// angles and tangent vectors are in seconds and internal units, slopes in frames and clip units
+	const double framesPerSecond = getFramesPerSecond(curve.unit) > 0 ? getFramesPerSecond(curve.unit) : 24;
+	const double valueScale = isAngular ? RadiansToDegrees : 1;
+
+	// the x, y of a weighted tangent is three times the offset of its control point
+	auto getWeightedTangent = [&](double x, double y) -> Tangent
+	{
+		if (x <= 0)
+			return { 0, 0 };
+		return { y * valueScale / (x * framesPerSecond), x * framesPerSecond / 3 };
+	};
+
+	for (size_t i = 0; i < curve.numFixedTangents; i++)
+	{
+		const FixedTangent &fixed = curve.fixedTangents[i];
+		if (fixed.key >= curve.numKeys)
+			continue;
+
+		if (curve.inTangentTypes[fixed.key] == TangentFixed)
+			inTangents[fixed.key] = curve.weighted ? getWeightedTangent(fixed.inX, fixed.inY) : Tangent{ tan(fixed.inAngle) * valueScale / framesPerSecond, -1 };
+		if (curve.outTangentTypes[fixed.key] == TangentFixed)
+			outTangents[fixed.key] = curve.weighted ? getWeightedTangent(fixed.outX, fixed.outY) : Tangent{ tan(fixed.outAngle) * valueScale / framesPerSecond, -1 };
+	}
+
+	computeSegments(inTangents, outTangents, curve.outTangentTypes);
+}
+
+void CurveEvaluator::prepare(const ChannelData &channel)
+{
+	CurveKeys keys;
+	CurveData curve;
+	getChannelCurveData(channel, keys, curve);
+	prepare(curve, false);
+}
+
+// Bezier cubics in the segment parameter s in [0, 1]. Control points a third of the segment away from the keys make the time
+// linear in s, so only segments with weighted tangents solve for s. Stepped segments keep the value of a key.
+void CurveEvaluator::computeSegments(const vector<Tangent> &inTangents, const vector<Tangent> &outTangents, const uint8_t *outTangentTypes)
+{
+	const size_t numKeys = m_times.size();
+	const size_t numSegments = numKeys > 1 ? numKeys - 1 : 0;
+	m_cubics.assign(numSegments * 3, 0.0);
+	m_timeCubics.clear();
+	m_segmentTypes.assign(numSegments, SegmentCubic);
+
+	for (size_t i = 0; i < numSegments; i++)
+	{
+		if (outTangentTypes[i] == TangentStep || outTangentTypes[i] == TangentStepNext)
+		{
+			m_segmentTypes[i] = outTangentTypes[i] == TangentStepNext ? SegmentStepNext : SegmentCubic;
+			continue;
+		}
+
+		const Tangent &out = outTangents[i];
+		const Tangent &in = inTangents[i + 1];
+
+		// weighted tangents longer than the segment would make the time go back
+		const double dt = m_times[i + 1] - m_times[i];
+		const double outLength = out.length < 0 ? dt / 3 : min(out.length, dt);
+		const double inLength = in.length < 0 ? dt / 3 : min(in.length, dt);
+
+		double *cubic = &m_cubics[i * 3];
+		const double delta = m_values[i + 1] - m_values[i];
+		const double m0 = 3 * out.slope * outLength;
+		const double m1 = 3 * in.slope * inLength;
+
+		cubic[0] = m0 + m1 - 2 * delta;
+		cubic[1] = 3 * delta - 2 * m0 - m1;
+		cubic[2] = m0;
+
+		if (out.length < 0 && in.length < 0)
+			continue;
+
+		if (m_timeCubics.empty())
+			m_timeCubics.assign(numSegments * 3, 0.0);
+
+		double *timeCubic = &m_timeCubics[i * 3];
+		timeCubic[0] = 3 * outLength + 3 * inLength - 2 * dt;
+		timeCubic[1] = 3 * dt - 6 * outLength - 3 * inLength;
+		timeCubic[2] = 3 * outLength;
+		m_segmentTypes[i] = SegmentBezier;
+	}
+
+	m_inSlope = numKeys > 0 ? inTangents.front().slope : 0;
+	m_outSlope = numKeys > 0 ? outTangents.back().slope : 0;
+}
+
+// s of the time by Newton steps, kept inside the bracket of the root by bisection
+double CurveEvaluator::evaluateBezier(size_t segment, double time) const
+{
+	const double *timeCubic = &m_timeCubics[segment * 3];
+	const double dt = m_times[segment + 1] - m_times[segment];
+	const double target = time - m_times[segment];
+
+	double low = 0, high = 1;
+	double s = target / dt;
+	for (int i = 0; i < MaxBezierIterations; i++)
+	{
+		const double error = ((timeCubic[0] * s + timeCubic[1]) * s + timeCubic[2]) * s - target;
+		if (fabs(error) <= BezierTolerance * dt)
+			break;
+
+		if (error < 0)
+			low = s;
+		else
+			high = s;
+
+		const double derivative = (3 * timeCubic[0] * s + 2 * timeCubic[1]) * s + timeCubic[2];
+		const double next = derivative > 0 ? s - error / derivative : low;
+		s = next > low && next < high ? next : (low + high) / 2;
+	}
+
+	const double *cubic = &m_cubics[segment * 3];
+	return ((cubic[0] * s + cubic[1]) * s + cubic[2]) * s + m_values[segment];
+}
+
+double CurveEvaluator::evaluateInside(double time, size_t &segment) const
+{
+	const size_t numSegments = m_times.size() - 1;
+
+	// the segment of the last call or the next one, then a binary search
+	if (segment >= numSegments || time < m_times[segment] || time >= m_times[segment + 1])
+	{
+		if (segment + 1 < numSegments && time >= m_times[segment + 1] && time < m_times[segment + 2])
+			segment++;
+		else
+			segment = min(numSegments - 1, (size_t)(upper_bound(m_times.begin(), m_times.end(), time) - m_times.begin()) - 1);
+	}
+
+	if (m_segmentTypes[segment] == SegmentBezier)
+		return evaluateBezier(segment, time);
+
+	const double s = (time - m_times[segment]) / (m_times[segment + 1] - m_times[segment]);
+
+	if (m_segmentTypes[segment] == SegmentStepNext)
+		return s > 0 ? m_values[segment + 1] : m_values[segment];
+
+	const double *cubic = &m_cubics[segment * 3];
+	return ((cubic[0] * s + cubic[1]) * s + cubic[2]) * s + m_values[segment];
+}
+
+double CurveEvaluator::evaluate(double time, size_t &segment) const
+{
+	const size_t numKeys = m_times.size();
+	if (numKeys == 0)
+		return 0;
+
+	const double first = m_times.front();
+	const double last = m_times.back();
+	const double span = last - first;
+
+	if (numKeys == 1 || span <= 0)
+		return m_values.front();
+
+	if (time >= first && time <= last)
+		return time == last ? m_values.back() : evaluateInside(time, segment);
+
+	const bool isBefore = time < first;
+	const int infinity = isBefore ? m_preInfinity : m_postInfinity;
+
+	if (infinity == InfinityLinear)
+		return isBefore ? m_values.front() + (time - first) * m_inSlope : m_values.back() + (time - last) * m_outSlope;
+
+	if (infinity != InfinityCycle && infinity != InfinityCycleRelative && infinity != InfinityOscillate)
+		return isBefore ? m_values.front() : m_values.back();
+
+	// cycles are counted from the first key, negative before it
+	const double cycle = floor((time - first) / span);
+	double local = time - cycle * span;
+
+	if (infinity == InfinityOscillate && fmod(fabs(cycle), 2) == 1)
+		local = last - (local - first);
+
+	double value = local >= last ? m_values.back() : evaluateInside(local, segment);
+	if (infinity == InfinityCycleRelative)
+		value += cycle * (m_values.back() - m_values.front());
+
+	return value;
+}
+
+void CurveEvaluator::sample(const double *times, size_t numTimes, double *values) const
+{
+	size_t segment = 0;
+	for (size_t i = 0; i < numTimes;)
+	{
+		const double time = times[i];
+		if (m_times.size() < 2 || time < m_times.front() || time >= m_times.back())
+		{
+			values[i++] = evaluate(time, segment);
+			continue;
+		}
+
+		values[i] = evaluateInside(time, segment);
+
+		// the following times in the same segment
+		const double start = m_times[segment];
+		const double end = m_times[segment + 1];
+		size_t runEnd = i + 1;
+		while (runEnd < numTimes && times[runEnd] >= start && times[runEnd] < end)
+			runEnd++;
+
+		if (m_segmentTypes[segment] == SegmentCubic)
+		{
+			// no branches, so the compiler vectorizes it
+			const double *cubic = &m_cubics[segment * 3];
+			const double a = cubic[0], b = cubic[1], c = cubic[2], d = m_values[segment];
+			const double scale = 1 / (end - start);
+			for (size_t j = i + 1; j < runEnd; j++)
+			{
+				const double s = (times[j] - start) * scale;
+				values[j] = ((a * s + b) * s + c) * s + d;
+			}
+		}
+		else
+		{
+			for (size_t j = i + 1; j < runEnd; j++)
+				values[j] = evaluateInside(times[j], segment);
+		}
+
+		i = runEnd;
+	}
+}
+
+void sampleCurves(const vector<const CurveEvaluator*> &curves, const double *times, size_t numTimes, double *values)
+{
+	parallelFor(curves.size(), getNumThreads(curves.size(), curves.size() * numTimes, MinParallelSamples), [&](size_t i)
+	{
+		curves[i]->sample(times, numTimes, values + i * numTimes);
+	});
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+
+#include "clip.h"
+
+using namespace std;
+
+// frames per second of an MTime::Unit, zero for an unknown unit
+double getFramesPerSecond(int timeUnit);
+
+// Fixed, linear, flat, spline, step and stepnext tangents have a known definition. Maya does not document the rules of
+// the others, clamped, plateau, auto, slow and fast, so curves using them are left to MFnAnimCurve.
+bool canEvaluate(const CurveData &curve);
+
+// Curve prepared for evaluation without Maya: sorted key times and values, and the cubic of every segment with the
+// tangents its tangent types give. Times are frames in the curve's unit, values are in clip units. Tangent types
+// canEvaluate rejects are evaluated as spline.
+class CurveEvaluator
+{
+public:
+	CurveEvaluator() {}
+
+	// fixed tangent angles relate internal units, radians for angular curves, to seconds as MFnAnimCurve gives them
+	void prepare(const CurveData &curve, bool isAngular);
+	void prepare(const ChannelData &channel); // linear keys at the samples
+
+	// segment is the index of the segment found by the last call, so playback finds the next one without a search
+	double evaluate(double time, size_t &segment) const;
+	double evaluate(double time) const { size_t segment = 0; return evaluate(time, segment); }
+
+	// values at many times, runs of times in the same segment are evaluated together, fastest for ascending times
+	void sample(const double *times, size_t numTimes, double *values) const;
+
+	size_t numKeys() const { return m_times.size(); }
+	int unit() const { return m_unit; }
+
+private:
+	// slope in clip units per frame, length is the time to the Bezier control point of a weighted tangent,
+	// negative for a third of the segment
+	struct Tangent
+	{
+		double slope;
+		double length;
+	};
+
+	double evaluateInside(double time, size_t &segment) const;
+	double evaluateBezier(size_t segment, double time) const;
+	void computeSegments(const vector<Tangent> &inTangents, const vector<Tangent> &outTangents, const uint8_t *outTangentTypes);
+
+	vector<double> m_times;
+	vector<double> m_values;
+	vector<double> m_cubics; // a, b, c of every segment, value = ((a * s + b) * s + c) * s + value of its first key
+	vector<double> m_timeCubics; // the same for the time of weighted segments, empty without them
+	vector<uint8_t> m_segmentTypes; // cubic, stepnext or weighted
+
+	double m_inSlope = 0; // at the first key, extrapolated by linear infinity
+	double m_outSlope = 0; // at the last key
+	int m_preInfinity = 0;
+	int m_postInfinity = 0;
+	int m_unit = 0;
+};
+
+// samples every curve at the same times on all cores, the values of curve i start at values + i * numTimes
+void sampleCurves(const vector<const CurveEvaluator*> &curves, const double *times, size_t numTimes, double *values);
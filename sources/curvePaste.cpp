@@ -0,0 +1,113 @@
+#include <cfloat>
+
+#include "curvePaste.h"
+
+int findPasteMode(const char *name)
+{
+	for (size_t i = 0; i < PasteModes.size(); i++)
+	{
+		if (PasteModes[i] == name)
+			return (int)i;
+	}
+	return -1;
+}
+
+void getPasteRange(const CurveData &pasted, double timeOffset, int mode, double &start, double &end)
+{
+	if (pasted.numKeys == 0)
+	{
+		start = DBL_MAX;
+		end = -DBL_MAX;
+		return;
+	}
+
+	start = pasted.times[0] + timeOffset;
+	end = mode == PasteInsert ? DBL_MAX : pasted.times[pasted.numKeys - 1] + timeOffset;
+}
+
+// appends keys of a curve in index order, with their fixed tangents
+class KeyAppender
+{
+public:
+	KeyAppender(const CurveData &curve, CurveKeys &result) : m_curve(curve), m_result(result), m_fixed(0) {}
+
+	void append(size_t i, double time)
+	{
+		while (m_fixed < m_curve.numFixedTangents && m_curve.fixedTangents[m_fixed].key < i)
+			m_fixed++;
+
+		if (m_fixed < m_curve.numFixedTangents && m_curve.fixedTangents[m_fixed].key == i)
+		{
+			m_result.fixedTangents.push_back(m_curve.fixedTangents[m_fixed]);
+			m_result.fixedTangents.back().key = (uint32_t)m_result.size();
+		}
+
+		m_result.times.push_back(time);
+		m_result.values.push_back(m_curve.values[i]);
+		m_result.inTangentTypes.push_back(m_curve.inTangentTypes[i]);
+		m_result.outTangentTypes.push_back(m_curve.outTangentTypes[i]);
+	}
+
+private:
+	const CurveData &m_curve;
+	CurveKeys &m_result;
+	size_t m_fixed;
+};
+
+void pasteKeys(const CurveData &existing, const CurveData &pasted, double timeOffset, int mode, CurveKeys &result)
+{
+	result.clear();
+	result.times.reserve(existing.numKeys + pasted.numKeys);
+	result.values.reserve(existing.numKeys + pasted.numKeys);
+	result.inTangentTypes.reserve(existing.numKeys + pasted.numKeys);
+	result.outTangentTypes.reserve(existing.numKeys + pasted.numKeys);
+
+	KeyAppender existingKeys(existing, result);
+	KeyAppender pastedKeys(pasted, result);
+
+	double start, end;
+	getPasteRange(pasted, timeOffset, PasteReplace, start, end);
+
+	size_t e = 0;
+	size_t p = 0;
+
+	// keys before the pasted ones are kept as they are
+	for (; e < existing.numKeys && existing.times[e] < start - PasteTimeTolerance; e++)
+		existingKeys.append(e, existing.times[e]);
+
+	if (mode == PasteMerge)
+	{
+		while (p < pasted.numKeys)
+		{
+			const double time = pasted.times[p] + timeOffset;
+			if (e < existing.numKeys && existing.times[e] < time - PasteTimeTolerance)
+			{
+				existingKeys.append(e, existing.times[e]);
+				e++;
+				continue;
+			}
+
+			// a pasted key replaces the key at its time
+			if (e < existing.numKeys && existing.times[e] <= time + PasteTimeTolerance)
+				e++;
+
+			pastedKeys.append(p, time);
+			p++;
+		}
+	}
+	else
+	{
+		for (; p < pasted.numKeys; p++)
+			pastedKeys.append(p, pasted.times[p] + timeOffset);
+
+		if (mode == PasteReplace)
+		{
+			while (e < existing.numKeys && existing.times[e] <= end + PasteTimeTolerance)
+				e++;
+		}
+	}
+
+	const double shift = mode == PasteInsert && pasted.numKeys > 0 ? end - start + 1 : 0;
+	for (; e < existing.numKeys; e++)
+		existingKeys.append(e, existing.times[e] + shift);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "clip.h"
+
+using namespace std;
+
+// how pasted keys are combined with the keys of a curve, in the order of PasteModes
+const int PasteMerge = 0; // pasted keys replace keys at their times, the keys between them are kept
+const int PasteReplace = 1; // keys from the first to the last pasted key are removed
+const int PasteInsert = 2; // keys from the first pasted key on are shifted after the last one
+
+const vector<string> PasteModes{ "merge", "replace", "insert" };
+
+// -1 for an unknown name
+int findPasteMode(const char *name);
+
+// keys closer than this in frames are at the same time
+const double PasteTimeTolerance = 1e-6;
+
+// Frames of a curve a paste changes: its keys in [start, end] are replaced by the result of pasteKeys. Insert changes
+// every key from the start on.
+void getPasteRange(const CurveData &pasted, double timeOffset, int mode, double &start, double &end);
+
+// The keys of the paste range of a curve combined with the pasted keys, shifted by the offset, in one sorted merge.
+// Times of both are in the unit of the pasted curve. Inserted keys are shifted by the pasted range and a frame.
+void pasteKeys(const CurveData &existing, const CurveData &pasted, double timeOffset, int mode, CurveKeys &result);
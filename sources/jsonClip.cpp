@@ -0,0 +1,929 @@
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "rapidjson/document.h"
+#include "rapidjson/reader.h"
+#include "rapidjson/error/en.h"
+
+#include "jsonClip.h"
+
+using namespace rapidjson;
+
+static bool readJsonCurve(const Value &animData, CurveKeys &keys, CurveData &curve)
+{
+	if (!animData.IsObject() || !animData.HasMember("data") || !animData["data"].IsArray())
+		return false;
+
+	curve.weighted = animData.HasMember("weighted") && animData["weighted"].GetBool();
+	curve.preInfinity = animData.HasMember("preinf") ? animData["preinf"].GetInt() : 0;
+	curve.postInfinity = animData.HasMember("postinf") ? animData["postinf"].GetInt() : 0;
+	curve.unit = animData.HasMember("unit") ? animData["unit"].GetInt() : 0;
+
+	const auto &data = animData["data"].GetArray();
+	keys.times.reserve(data.Size());
+	keys.values.reserve(data.Size());
+	keys.inTangentTypes.reserve(data.Size());
+	keys.outTangentTypes.reserve(data.Size());
+
+	for (const auto& frameData : data)
+	{
+		if (!frameData.IsArray() || frameData.Size() < 4 || !frameData[2].IsString() || !frameData[3].IsString())
+			return false;
+
+		const auto &fdata = frameData.GetArray();
+		const int itt = findTangentType(fdata[2].GetString());
+		const int ott = findTangentType(fdata[3].GetString());
+		if (itt < 0 || ott < 0)
+			return false;
+
+		if (itt == TangentFixed || ott == TangentFixed)
+		{
+			if (fdata.Size() < (curve.weighted ? 14u : 10u))
+				return false;
+
+			FixedTangent ft = {};
+			ft.key = (uint32_t)keys.size();
+			ft.weightsLocked = fdata[4].GetBool();
+			ft.tangentsLocked = fdata[5].GetBool();
+			ft.inAngle = fdata[6].GetDouble();
+			ft.outAngle = fdata[7].GetDouble();
+			ft.inWeight = fdata[8].GetDouble();
+			ft.outWeight = fdata[9].GetDouble();
+
+			if (curve.weighted)
+			{
+				ft.inX = fdata[10].GetDouble();
+				ft.inY = fdata[11].GetDouble();
+				ft.outX = fdata[12].GetDouble();
+				ft.outY = fdata[13].GetDouble();
+			}
+
+			keys.fixedTangents.push_back(ft);
+		}
+
+		keys.times.push_back(fdata[0].GetDouble());
+		keys.values.push_back(fdata[1].GetDouble());
+		keys.inTangentTypes.push_back((uint8_t)itt);
+		keys.outTangentTypes.push_back((uint8_t)ott);
+	}
+
+	curve.setKeys(keys);
+	return true;
+}
+
+static bool readJsonChannel(const Value &channelData, vector<double> &values, ChannelData &channel)
+{
+	if (!channelData.IsObject() || !channelData.HasMember("values") || !channelData["values"].IsArray())
+		return false;
+
+	channel.unit = channelData.HasMember("unit") ? channelData["unit"].GetInt() : 0;
+	channel.start = channelData.HasMember("start") ? channelData["start"].GetDouble() : 0;
+	channel.step = channelData.HasMember("step") ? channelData["step"].GetDouble() : 1;
+	if (channel.step <= 0)
+		return false;
+
+	const auto &data = channelData["values"].GetArray();
+	values.reserve(data.Size());
+	for (const auto &value : data)
+	{
+		if (!value.IsNumber())
+			return false;
+		values.push_back(value.GetDouble());
+	}
+
+	channel.numValues = values.size();
+	channel.values = values.data();
+	return true;
+}
+
+// Reads a mapped file in place and the end of the file reads as the terminating zero. Strings are unescaped within the copy
+// on write mapping and terminated over their closing quote. Characters already in place are not written again, but every
+// terminator still writes, so each page where a string ends gets a private copy. As every key names its tangents, that
+// is nearly every page of the clip.
+class MappedInsituStream
+{
+public:
+	typedef char Ch;
+
+	MappedInsituStream(char *data, size_t size) : m_src(data), m_dst(nullptr), m_head(data), m_end(data + size) {}
+
+	Ch Peek() const { return m_src != m_end ? *m_src : '\0'; }
+	Ch Take() { return m_src != m_end ? *m_src++ : '\0'; }
+	size_t Tell() const { return (size_t)(m_src - m_head); }
+
+	void Put(Ch c)
+	{
+		if (*m_dst != c)
+			*m_dst = c;
+		m_dst++;
+	}
+	Ch* PutBegin() { return m_dst = m_src; }
+	size_t PutEnd(Ch *begin) { return (size_t)(m_dst - begin); }
+	void Flush() {}
+
+private:
+	char *m_src;
+	char *m_dst;
+	char *m_head;
+	char *m_end;
+};
+
+// Decodes a clip straight from the parser events into key columns, without building a document.
+// Nodes rejected by the filter are parsed but never stored.
+class JsonClipHandler : public BaseReaderHandler<UTF8<>, JsonClipHandler>
+{
+public:
+	JsonClipHandler(Clip &clip, const ClipNodeFilter &filter) : m_clip(clip), m_filter(filter) {}
+
+	const string& error() const { return m_error; }
+
+	bool Null() { return scalar(); }
+	bool Bool(bool b);
+	bool Int(int i) { return integer(i); }
+	bool Uint(unsigned int i) { return integer(i); }
+	bool Int64(int64_t i) { return integer(i); }
+	bool Uint64(uint64_t i) { return integer((int64_t)i); }
+	bool Double(double d) { return number(d); }
+	bool String(const char *str, SizeType length, bool copy);
+
+	bool StartObject();
+	bool Key(const char *str, SizeType length, bool copy);
+	bool EndObject(SizeType memberCount);
+	bool StartArray();
+	bool EndArray(SizeType elementCount);
+
+private:
+	enum State
+	{
+		Start, Nodes, NodeValue, Node,
+		AnimationValue, Animation, CurveValue, Curve, Weighted, PreInfinity, PostInfinity, Unit, DataValue, Data, KeyFields,
+		BakedValue, Baked, ChannelValue, Channel, ChannelUnit, ChannelStart, ChannelStep, ValuesValue, Values,
+		StaticsValue, Statics, StaticValue,
+		SkipValue, Done
+	};
+
+	bool scalar();
+	bool integer(int64_t i);
+	bool number(double d);
+
+	// skips the current object or array and continues in the given state
+	bool skipContainer(State state)
+	{
+		m_skipDepth = 1;
+		m_state = state;
+		return true;
+	}
+
+	bool invalidCurve()
+	{
+		m_error = "Invalid animation data for '" + string(m_node->name) + "." + m_attr + "'";
+		return false;
+	}
+
+	bool invalidChannel()
+	{
+		m_error = "Invalid baked data for '" + string(m_node->name) + "." + m_attr + "'";
+		return false;
+	}
+
+	bool isFixedKey() const { return m_itt == TangentFixed || m_ott == TangentFixed; }
+
+	bool endKey();
+	bool endCurve();
+	bool endChannel();
+
+	Clip &m_clip;
+	const ClipNodeFilter &m_filter;
+	string m_error;
+
+	State m_state = Start;
+	State m_skipState = Start; // state after a skipped value
+	int m_skipDepth = 0;
+
+	const char *m_nodeName = nullptr;
+	size_t m_nodeNameLength = 0;
+	ClipNode *m_node = nullptr;
+	const char *m_attr = nullptr;
+	uint32_t m_attrId = 0;
+
+	// current curve, its keys are copied into exactly sized columns when the curve ends
+	CurveData m_curve;
+	CurveKeys m_keys;
+	bool m_hasData = false;
+	size_t m_minFixedFields = 0;
+
+	// current channel
+	ChannelData m_channel;
+	vector<double> m_values;
+
+	// current key
+	size_t m_field = 0;
+	int m_itt = 0;
+	int m_ott = 0;
+	FixedTangent m_fixed = {};
+};
+
+bool JsonClipHandler::scalar()
+{
+	if (m_skipDepth > 0)
+		return true;
+
+	switch (m_state)
+	{
+	case NodeValue: m_state = Nodes; return true;
+	case AnimationValue: case BakedValue: case StaticsValue: m_state = Node; return true;
+	case StaticValue: m_state = Statics; return true;
+	case SkipValue: m_state = m_skipState; return true;
+	case KeyFields:
+		if (m_field < 4 || (isFixedKey() && m_field < 10))
+			return invalidCurve();
+		m_field++; // fields after the tangent types are only read for fixed tangents
+		return true;
+	case CurveValue: case Curve: case Weighted: case PreInfinity: case PostInfinity: case Unit: case DataValue: case Data:
+		return invalidCurve();
+	case ChannelValue: case Channel: case ChannelUnit: case ChannelStart: case ChannelStep: case ValuesValue: case Values:
+		return invalidChannel();
+	case Start:
+		m_error = "Json clip must be an object";
+		return false;
+	default:
+		return false;
+	}
+}
+
+bool JsonClipHandler::Bool(bool b)
+{
+	if (m_skipDepth > 0)
+		return true;
+
+	if (m_state == Weighted)
+	{
+		m_curve.weighted = b;
+		m_state = Curve;
+		return true;
+	}
+
+	if (m_state == KeyFields && (m_field == 4 || m_field == 5) && isFixedKey())
+	{
+		if (m_field == 4)
+			m_fixed.weightsLocked = b;
+		else
+			m_fixed.tangentsLocked = b;
+		m_field++;
+		return true;
+	}
+
+	return scalar();
+}
+
+bool JsonClipHandler::integer(int64_t i)
+{
+	if (m_skipDepth > 0)
+		return true;
+
+	switch (m_state)
+	{
+	case PreInfinity: m_curve.preInfinity = (int)i; break;
+	case PostInfinity: m_curve.postInfinity = (int)i; break;
+	case Unit: m_curve.unit = (int)i; break;
+	case ChannelUnit: m_channel.unit = (int)i; m_state = Channel; return true;
+	default: return number((double)i);
+	}
+
+	m_state = Curve;
+	return true;
+}
+
+bool JsonClipHandler::number(double d)
+{
+	if (m_skipDepth > 0)
+		return true;
+
+	if (m_state == StaticValue)
+	{
+		m_node->statics.push_back({ m_attr, m_attrId, d });
+		m_state = Statics;
+		return true;
+	}
+
+	switch (m_state)
+	{
+	case Values: m_values.push_back(d); return true;
+	case ChannelStart: m_channel.start = d; m_state = Channel; return true;
+	case ChannelStep: m_channel.step = d; m_state = Channel; return true;
+	default: break;
+	}
+
+	if (m_state == KeyFields)
+	{
+		switch (m_field)
+		{
+		case 0: m_keys.times.push_back(d); break;
+		case 1: m_keys.values.push_back(d); break;
+		case 2: case 3: return invalidCurve();
+		case 4: case 5: if (isFixedKey()) return invalidCurve(); break;
+		case 6: m_fixed.inAngle = d; break;
+		case 7: m_fixed.outAngle = d; break;
+		case 8: m_fixed.inWeight = d; break;
+		case 9: m_fixed.outWeight = d; break;
+		case 10: m_fixed.inX = d; break;
+		case 11: m_fixed.inY = d; break;
+		case 12: m_fixed.outX = d; break;
+		case 13: m_fixed.outY = d; break;
+		}
+		m_field++;
+		return true;
+	}
+
+	return scalar();
+}
+
+bool JsonClipHandler::String(const char *str, SizeType length, bool)
+{
+	if (m_skipDepth > 0)
+		return true;
+
+	if (m_state == KeyFields && (m_field == 2 || m_field == 3))
+	{
+		const int type = findTangentType(str, length);
+		if (type < 0)
+			return invalidCurve();
+
+		if (m_field == 2)
+			m_itt = type;
+		else
+			m_ott = type;
+		m_field++;
+		return true;
+	}
+
+	return scalar();
+}
+
+bool JsonClipHandler::StartObject()
+{
+	if (m_skipDepth > 0)
+	{
+		m_skipDepth++;
+		return true;
+	}
+
+	switch (m_state)
+	{
+	case Start:
+		m_state = Nodes;
+		return true;
+
+	case NodeValue:
+		if (m_filter && !m_filter(m_nodeName))
+			return skipContainer(Nodes);
+
+		m_node = &m_clip.addNode(m_clip.addName(m_nodeName, m_nodeNameLength, false));
+		m_state = Node;
+		return true;
+
+	case AnimationValue:
+		m_state = Animation;
+		return true;
+
+	case BakedValue:
+		m_state = Baked;
+		return true;
+
+	case ChannelValue:
+		m_channel = ChannelData();
+		m_values.clear();
+		m_hasData = false;
+		m_state = Channel;
+		return true;
+
+	case CurveValue:
+		m_curve = CurveData();
+		m_keys.clear();
+		m_hasData = false;
+		m_minFixedFields = SIZE_MAX;
+		m_state = Curve;
+		return true;
+
+	case StaticsValue:
+		m_state = Statics;
+		return true;
+
+	case StaticValue:
+		return skipContainer(Statics);
+
+	case SkipValue:
+		return skipContainer(m_skipState);
+
+	case KeyFields:
+		if (m_field < 4 || (isFixedKey() && m_field < 10))
+			return invalidCurve();
+		m_field++;
+		return skipContainer(KeyFields);
+
+	case Channel: case ChannelUnit: case ChannelStart: case ChannelStep: case ValuesValue: case Values:
+		return invalidChannel();
+
+	default:
+		return m_state == Done ? false : invalidCurve();
+	}
+}
+
+bool JsonClipHandler::Key(const char *str, SizeType length, bool)
+{
+	if (m_skipDepth > 0)
+		return true;
+
+	switch (m_state)
+	{
+	case Nodes:
+		m_nodeName = str; // in situ strings live as long as the mapping
+		m_nodeNameLength = length;
+		m_state = NodeValue;
+		return true;
+
+	case Node:
+		if (strcmp(str, "animation") == 0)
+			m_state = AnimationValue;
+		else if (strcmp(str, "baked") == 0)
+			m_state = BakedValue;
+		else if (strcmp(str, "static") == 0)
+			m_state = StaticsValue;
+		else
+		{
+			m_skipState = Node;
+			m_state = SkipValue;
+		}
+		return true;
+
+	case Animation:
+		m_attrId = m_clip.addName(str, length, false);
+		m_attr = m_clip.names().get(m_attrId);
+		m_state = CurveValue;
+		return true;
+
+	case Curve:
+		if (strcmp(str, "weighted") == 0)
+			m_state = Weighted;
+		else if (strcmp(str, "preinf") == 0)
+			m_state = PreInfinity;
+		else if (strcmp(str, "postinf") == 0)
+			m_state = PostInfinity;
+		else if (strcmp(str, "unit") == 0)
+			m_state = Unit;
+		else if (strcmp(str, "data") == 0)
+			m_state = DataValue;
+		else
+		{
+			m_skipState = Curve;
+			m_state = SkipValue;
+		}
+		return true;
+
+	case Baked:
+		m_attrId = m_clip.addName(str, length, false);
+		m_attr = m_clip.names().get(m_attrId);
+		m_state = ChannelValue;
+		return true;
+
+	case Channel:
+		if (strcmp(str, "unit") == 0)
+			m_state = ChannelUnit;
+		else if (strcmp(str, "start") == 0)
+			m_state = ChannelStart;
+		else if (strcmp(str, "step") == 0)
+			m_state = ChannelStep;
+		else if (strcmp(str, "values") == 0)
+			m_state = ValuesValue;
+		else
+		{
+			m_skipState = Channel;
+			m_state = SkipValue;
+		}
+		return true;
+
+	case Statics:
+		m_attrId = m_clip.addName(str, length, false);
+		m_attr = m_clip.names().get(m_attrId);
+		m_state = StaticValue;
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+bool JsonClipHandler::EndObject(SizeType)
+{
+	if (m_skipDepth > 0)
+	{
+		m_skipDepth--;
+		return true;
+	}
+
+	switch (m_state)
+	{
+	case Nodes: m_state = Done; return true;
+	case Node: m_state = Nodes; return true;
+	case Animation: case Baked: case Statics: m_state = Node; return true;
+	case Curve: return endCurve();
+	case Channel: return endChannel();
+	default: return false;
+	}
+}
+
+bool JsonClipHandler::StartArray()
+{
+	if (m_skipDepth > 0)
+	{
+		m_skipDepth++;
+		return true;
+	}
+
+	switch (m_state)
+	{
+	case NodeValue: return skipContainer(Nodes);
+	case AnimationValue: case BakedValue: case StaticsValue: return skipContainer(Node);
+	case StaticValue: return skipContainer(Statics);
+	case SkipValue: return skipContainer(m_skipState);
+
+	case DataValue:
+		m_hasData = true;
+		m_state = Data;
+		return true;
+
+	case ValuesValue:
+		m_hasData = true;
+		m_state = Values;
+		return true;
+
+	case ChannelValue: case Channel: case ChannelUnit: case ChannelStart: case ChannelStep: case Values:
+		return invalidChannel();
+
+	case Data:
+		m_field = 0;
+		m_fixed = FixedTangent();
+		m_state = KeyFields;
+		return true;
+
+	case KeyFields:
+		if (m_field < 4 || (isFixedKey() && m_field < 10))
+			return invalidCurve();
+		m_field++;
+		return skipContainer(KeyFields);
+
+	case Start:
+		m_error = "Json clip must be an object";
+		return false;
+
+	default:
+		return m_state == Done ? false : invalidCurve();
+	}
+}
+
+bool JsonClipHandler::EndArray(SizeType)
+{
+	if (m_skipDepth > 0)
+	{
+		m_skipDepth--;
+		return true;
+	}
+
+	if (m_state == KeyFields)
+		return endKey();
+
+	if (m_state == Data)
+	{
+		m_state = Curve;
+		return true;
+	}
+
+	if (m_state == Values)
+	{
+		m_state = Channel;
+		return true;
+	}
+
+	return false;
+}
+
+bool JsonClipHandler::endKey()
+{
+	if (m_field < 4)
+		return invalidCurve();
+
+	if (m_itt == TangentFixed || m_ott == TangentFixed)
+	{
+		m_fixed.key = (uint32_t)m_keys.inTangentTypes.size();
+		m_keys.fixedTangents.push_back(m_fixed);
+		m_minFixedFields = min(m_minFixedFields, m_field);
+	}
+
+	m_keys.inTangentTypes.push_back((uint8_t)m_itt);
+	m_keys.outTangentTypes.push_back((uint8_t)m_ott);
+	m_state = Data;
+	return true;
+}
+
+bool JsonClipHandler::endCurve()
+{
+	// weighted may follow the data, so fixed tangents are validated once the curve is complete
+	if (!m_hasData || (!m_keys.fixedTangents.empty() && m_minFixedFields < (m_curve.weighted ? 14u : 10u)))
+		return invalidCurve();
+
+	CurveKeys &keys = m_clip.addKeys();
+	keys.times.assign(m_keys.times.begin(), m_keys.times.end());
+	keys.values.assign(m_keys.values.begin(), m_keys.values.end());
+	keys.inTangentTypes.assign(m_keys.inTangentTypes.begin(), m_keys.inTangentTypes.end());
+	keys.outTangentTypes.assign(m_keys.outTangentTypes.begin(), m_keys.outTangentTypes.end());
+	keys.fixedTangents.assign(m_keys.fixedTangents.begin(), m_keys.fixedTangents.end());
+
+	if (!m_curve.weighted)
+	{
+		for (auto &ft : keys.fixedTangents)
+			ft.inX = ft.inY = ft.outX = ft.outY = 0;
+	}
+
+	m_curve.setKeys(keys);
+	m_node->curves.push_back({ m_attr, m_attrId, m_curve });
+	m_state = Animation;
+	return true;
+}
+
+bool JsonClipHandler::endChannel()
+{
+	if (!m_hasData || m_channel.step <= 0)
+		return invalidChannel();
+
+	vector<double> &values = m_clip.addValues();
+	values.assign(m_values.begin(), m_values.end());
+
+	m_channel.numValues = values.size();
+	m_channel.values = values.data();
+	m_node->channels.push_back({ m_attr, m_attrId, m_channel });
+	m_state = Baked;
+	return true;
+}
+
+bool readJsonClip(Clip &clip, string &error, Profiler *profiler, const ClipNodeFilter &filter)
+{
+	Profiler noProfiler;
+	Profiler &prof = profiler ? *profiler : noProfiler;
+	Profiler::Scope scope(prof, "parse");
+
+	MappedFile &file = clip.file();
+	if (!file.writableData())
+	{
+		error = "Json clip must be mapped copy on write";
+		return false;
+	}
+
+	MappedInsituStream stream(file.writableData(), file.size());
+	JsonClipHandler handler(clip, filter);
+
+	Reader reader;
+	const ParseResult result = reader.Parse<kParseInsituFlag>(stream, handler);
+	if (result.IsError())
+	{
+		if (!handler.error().empty())
+			error = handler.error();
+		else
+			error = "Cannot parse json clip: " + string(GetParseError_En(result.Code())) + " at offset " + to_string(result.Offset());
+		return false;
+	}
+
+	return true;
+}
+
+bool decodeJsonClip(const Value &doc, Clip &clip, string &error)
+{
+	if (!doc.IsObject())
+	{
+		error = "Json clip must be an object";
+		return false;
+	}
+
+	for (const auto &nodeData : doc.GetObject())
+	{
+		if (!nodeData.value.IsObject())
+			continue;
+
+		ClipNode &node = clip.addNode(clip.addName(nodeData.name.GetString(), nodeData.name.GetStringLength()));
+
+		const auto animation = nodeData.value.FindMember("animation");
+		if (animation != nodeData.value.MemberEnd() && animation->value.IsObject())
+		{
+			for (const auto &data : animation->value.GetObject()) // per every animation curve data
+			{
+				ClipCurve curve;
+				curve.attrId = clip.addName(data.name.GetString(), data.name.GetStringLength());
+				curve.attr = clip.names().get(curve.attrId);
+
+				if (!readJsonCurve(data.value, clip.addKeys(), curve.data))
+				{
+					error = "Invalid animation data for '" + string(node.name) + "." + curve.attr + "'";
+					return false;
+				}
+
+				node.curves.push_back(curve);
+			}
+		}
+
+		const auto baked = nodeData.value.FindMember("baked");
+		if (baked != nodeData.value.MemberEnd() && baked->value.IsObject())
+		{
+			for (const auto &data : baked->value.GetObject()) // per every baked channel
+			{
+				ClipChannel channel;
+				channel.attrId = clip.addName(data.name.GetString(), data.name.GetStringLength());
+				channel.attr = clip.names().get(channel.attrId);
+
+				if (!readJsonChannel(data.value, clip.addValues(), channel.data))
+				{
+					error = "Invalid baked data for '" + string(node.name) + "." + channel.attr + "'";
+					return false;
+				}
+
+				node.channels.push_back(channel);
+			}
+		}
+
+		const auto statics = nodeData.value.FindMember("static");
+		if (statics != nodeData.value.MemberEnd() && statics->value.IsObject())
+		{
+			for (const auto &attrData : statics->value.GetObject()) // per every static attribute
+			{
+				if (attrData.value.IsNumber())
+				{
+					const uint32_t attrId = clip.addName(attrData.name.GetString(), attrData.name.GetStringLength());
+					node.statics.push_back({ clip.names().get(attrId), attrId, attrData.value.GetDouble() });
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+JsonClipWriter::JsonClipWriter() : m_writer(m_output), m_section(NoSection)
+{
+}
+
+JsonClipWriter::~JsonClipWriter()
+{
+	discard();
+}
+
+bool JsonClipWriter::open(const char *filePath)
+{
+	discard();
+
+	if (!m_output.open(filePath))
+		return false;
+
+	m_writer.Reset(m_output);
+	m_writer.StartObject();
+	return true;
+}
+
+void JsonClipWriter::beginNode(const char *name)
+{
+	m_writer.Key(name);
+	m_writer.StartObject();
+	m_section = NoSection;
+}
+
+// animation and static sections are always written, the baked section only when there are channels
+void JsonClipWriter::beginSection(Section section)
+{
+	if (m_section == section)
+		return;
+
+	if (m_section != NoSection)
+		m_writer.EndObject();
+
+	if (m_section < AnimationSection && section > AnimationSection)
+	{
+		m_writer.Key("animation");
+		m_writer.StartObject();
+		m_writer.EndObject();
+	}
+
+	m_section = section;
+	m_writer.Key(section == AnimationSection ? "animation" : section == BakedSection ? "baked" : "static");
+	m_writer.StartObject();
+}
+
+void JsonClipWriter::writeCurve(const char *attr, const CurveData &curve)
+{
+	beginSection(AnimationSection);
+
+	Writer<OutputFile> &writer = m_writer;
+
+	writer.Key(attr);
+	writer.StartObject();
+	writer.Key("weighted");
+	writer.Bool(curve.weighted);
+	writer.Key("preinf");
+	writer.Int(curve.preInfinity);
+	writer.Key("postinf");
+	writer.Int(curve.postInfinity);
+	writer.Key("unit");
+	writer.Int(curve.unit);
+	writer.Key("data");
+	writer.StartArray();
+
+	const FixedTangent *fixed = curve.fixedTangents;
+	const FixedTangent *fixedEnd = curve.fixedTangents + curve.numFixedTangents;
+
+	for (size_t i = 0; i < curve.numKeys; i++)
+	{
+		const string &itt = TangentTypes[curve.inTangentTypes[i]];
+		const string &ott = TangentTypes[curve.outTangentTypes[i]];
+
+		writer.StartArray();
+		writer.Double(curve.times[i]);
+		writer.Double(curve.values[i]);
+		writer.String(itt.c_str(), (SizeType)itt.size());
+		writer.String(ott.c_str(), (SizeType)ott.size());
+
+		if (fixed != fixedEnd && fixed->key == i)
+		{
+			writer.Bool(fixed->weightsLocked != 0);
+			writer.Bool(fixed->tangentsLocked != 0);
+			writer.Double(fixed->inAngle);
+			writer.Double(fixed->outAngle);
+			writer.Double(fixed->inWeight);
+			writer.Double(fixed->outWeight);
+
+			if (curve.weighted)
+			{
+				writer.Double(fixed->inX);
+				writer.Double(fixed->inY);
+				writer.Double(fixed->outX);
+				writer.Double(fixed->outY);
+			}
+
+			fixed++;
+		}
+
+		writer.EndArray();
+	}
+
+	writer.EndArray();
+	writer.EndObject();
+}
+
+void JsonClipWriter::writeChannel(const char *attr, const ChannelData &channel)
+{
+	beginSection(BakedSection);
+
+	Writer<OutputFile> &writer = m_writer;
+
+	writer.Key(attr);
+	writer.StartObject();
+	writer.Key("unit");
+	writer.Int(channel.unit);
+	writer.Key("start");
+	writer.Double(channel.start);
+	writer.Key("step");
+	writer.Double(channel.step);
+	writer.Key("values");
+	writer.StartArray();
+
+	for (size_t i = 0; i < channel.numValues; i++)
+		writer.Double(channel.values[i]);
+
+	writer.EndArray();
+	writer.EndObject();
+}
+
+void JsonClipWriter::writeStatic(const char *attr, double value)
+{
+	beginSection(StaticSection);
+
+	m_writer.Key(attr);
+	m_writer.Double(value);
+}
+
+void JsonClipWriter::endNode()
+{
+	beginSection(StaticSection);
+	m_writer.EndObject();
+
+	m_writer.Key("others");
+	m_writer.StartObject();
+	m_writer.EndObject();
+
+	m_writer.EndObject();
+}
+
+bool JsonClipWriter::close()
+{
+	if (!m_output.isOpen())
+		return false;
+
+	m_writer.EndObject();
+	return m_output.close();
+}
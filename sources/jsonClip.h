@@ -0,0 +1,41 @@
+#pragma once
+
+#include "rapidjson/fwd.h"
+#include "rapidjson/writer.h"
+
+#include "clip.h"
+
+// Parses the clip's copy on write mapped file in place and decodes its curves into key columns without a document.
+// Names point into the mapping, which lives as long as the clip. Nodes rejected by the filter are skipped.
+bool readJsonClip(Clip &clip, string &error, Profiler *profiler = nullptr, const ClipNodeFilter &filter = nullptr);
+
+// Decodes an already parsed json clip, names are copied into the clip
+bool decodeJsonClip(const rapidjson::Value &doc, Clip &clip, string &error);
+
+// Streams a clip to a json file as { node: { "animation": { attr: curve }, "baked": { attr: channel }, "static": { attr: value }, "others": {} } },
+// where "baked" is written only for nodes with channels
+class JsonClipWriter : public ClipWriter
+{
+public:
+	JsonClipWriter();
+	~JsonClipWriter();
+
+	bool open(const char *filePath) override;
+
+	void beginNode(const char *name) override;
+	void writeCurve(const char *attr, const CurveData &curve) override;
+	void writeChannel(const char *attr, const ChannelData &channel) override;
+	void writeStatic(const char *attr, double value) override;
+	void endNode() override;
+
+	bool close() override;
+
+private:
+	enum Section { NoSection, AnimationSection, BakedSection, StaticSection };
+
+	void beginSection(Section section);
+
+	rapidjson::Writer<OutputFile> m_writer;
+
+	Section m_section;
+};
@@ -0,0 +1,59 @@
+#include "keyJournal.h"
+
+size_t KeyJournal::add(const CurveData &curve)
+{
+	Snapshot snapshot;
+	snapshot.firstKey = m_keys.size();
+	snapshot.numKeys = curve.numKeys;
+	snapshot.firstFixed = m_keys.fixedTangents.size();
+	snapshot.numFixed = curve.numFixedTangents;
+	snapshot.weighted = curve.weighted;
+	snapshot.unit = curve.unit;
+
+	m_keys.times.insert(m_keys.times.end(), curve.times, curve.times + curve.numKeys);
+	m_keys.values.insert(m_keys.values.end(), curve.values, curve.values + curve.numKeys);
+	m_keys.inTangentTypes.insert(m_keys.inTangentTypes.end(), curve.inTangentTypes, curve.inTangentTypes + curve.numKeys);
+	m_keys.outTangentTypes.insert(m_keys.outTangentTypes.end(), curve.outTangentTypes, curve.outTangentTypes + curve.numKeys);
+	m_keys.fixedTangents.insert(m_keys.fixedTangents.end(), curve.fixedTangents, curve.fixedTangents + curve.numFixedTangents);
+
+	m_snapshots.push_back(snapshot);
+	return m_snapshots.size() - 1;
+}
+
+CurveData KeyJournal::get(size_t index) const
+{
+	const Snapshot &snapshot = m_snapshots[index];
+
+	CurveData curve;
+	curve.weighted = snapshot.weighted;
+	curve.unit = snapshot.unit;
+	curve.numKeys = snapshot.numKeys;
+	curve.times = m_keys.times.data() + snapshot.firstKey;
+	curve.values = m_keys.values.data() + snapshot.firstKey;
+	curve.inTangentTypes = m_keys.inTangentTypes.data() + snapshot.firstKey;
+	curve.outTangentTypes = m_keys.outTangentTypes.data() + snapshot.firstKey;
+	curve.numFixedTangents = snapshot.numFixed;
+	curve.fixedTangents = m_keys.fixedTangents.data() + snapshot.firstFixed;
+	return curve;
+}
+
+static size_t getMemorySize(size_t numKeys, size_t numFixed)
+{
+	return numKeys * (2 * sizeof(double) + 2 * sizeof(uint8_t)) + numFixed * sizeof(FixedTangent);
+}
+
+size_t KeyJournal::memorySize() const
+{
+	return getMemorySize(m_keys.size(), m_keys.fixedTangents.size()) + m_snapshots.size() * sizeof(Snapshot);
+}
+
+size_t KeyJournal::memorySize(const CurveData &curve)
+{
+	return getMemorySize(curve.numKeys, curve.numFixedTangents) + sizeof(Snapshot);
+}
+
+void KeyJournal::clear()
+{
+	m_keys = CurveKeys();
+	m_snapshots = vector<Snapshot>();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "clip.h"
+
+using namespace std;
+
+// Snapshots of the keys of many curves appended to shared columns, so keeping thousands of curves costs a few
+// allocations and no per key objects. Fixed tangents keep key indices relative to their snapshot.
+class KeyJournal
+{
+public:
+	// index of the snapshot, the weighted flag and unit of the curve are kept with its keys
+	size_t add(const CurveData &curve);
+
+	// points into the columns, valid until the next add or clear
+	CurveData get(size_t index) const;
+
+	size_t size() const { return m_snapshots.size(); }
+
+	// bytes of the kept keys
+	size_t memorySize() const;
+	static size_t memorySize(const CurveData &curve);
+
+	// frees the columns
+	void clear();
+
+private:
+	struct Snapshot
+	{
+		size_t firstKey;
+		size_t numKeys;
+		size_t firstFixed;
+		size_t numFixed;
+		bool weighted;
+		int unit;
+	};
+
+	CurveKeys m_keys;
+	vector<Snapshot> m_snapshots;
+};
@@ -0,0 +1,233 @@
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include <cstdio>
+
+#include "keyReduction.h"
+#include "parallel.h"
+
+// index of the error in ReductionStats
+static int getToleranceKind(int animCurveType)
+{
+	if (isAngularCurveType(animCurveType))
+		return 0;
+
+	return animCurveType == 1 || animCurveType == 5 ? 1 : 2; // animCurveTL, animCurveUL
+}
+
+static bool isReducible(const CurveData &curve)
+{
+	bool isLinear = true;
+	bool isDense = true;
+
+	for (size_t i = 0; i < curve.numKeys; i++)
+	{
+		const uint8_t itt = curve.inTangentTypes[i];
+		const uint8_t ott = curve.outTangentTypes[i];
+
+		if (itt == TangentFixed || ott == TangentFixed || itt == TangentStep || ott == TangentStep || itt == TangentStepNext || ott == TangentStepNext)
+			return false;
+
+		// equal times would divide by zero when measuring the error
+		if (i > 0 && curve.times[i] <= curve.times[i - 1])
+			return false;
+
+		isLinear = isLinear && itt == TangentLinear && ott == TangentLinear;
+		isDense = isDense && (i == 0 || curve.times[i] - curve.times[i - 1] <= 1 + 1e-6);
+	}
+
+	return isLinear || isDense;
+}
+
+// the middle of the value range, so every value is within half the range of it
+static bool getConstantValue(const double *values, size_t numValues, double tolerance, double &value)
+{
+	if (numValues == 0)
+		return false;
+
+	const auto range = minmax_element(values, values + numValues);
+	value = *range.first == *range.second ? *range.first : (*range.first + *range.second) / 2; // exact for equal values
+	return *range.second - *range.first <= 2 * tolerance;
+}
+
+bool isConstantCurve(const CurveData &curve, double tolerance, double &value)
+{
+	if (!getConstantValue(curve.values, curve.numKeys, tolerance, value))
+		return false;
+
+	for (size_t i = 0; i < curve.numFixedTangents; i++)
+	{
+		const FixedTangent &fixed = curve.fixedTangents[i];
+		if (fixed.inAngle != 0 || fixed.outAngle != 0 || (curve.weighted && (fixed.inY != 0 || fixed.outY != 0)))
+			return false;
+	}
+
+	// slopes and offsets of keys within the tolerance would extrapolate away from it
+	double exactValue;
+	const bool isExact = getConstantValue(curve.values, curve.numKeys, 0, exactValue);
+	const bool extrapolates = curve.preInfinity == InfinityLinear || curve.preInfinity == InfinityCycleRelative ||
+		curve.postInfinity == InfinityLinear || curve.postInfinity == InfinityCycleRelative;
+
+	return isExact || !extrapolates;
+}
+
+bool isConstantChannel(const ChannelData &channel, double tolerance, double &value)
+{
+	return getConstantValue(channel.values, channel.numValues, tolerance, value);
+}
+
+bool reduceCurve(const CurveData &curve, double tolerance, CurveKeys &keys, CurveData &reduced, double &maxError)
+{
+	keys.clear();
+	maxError = 0;
+
+	if (tolerance <= 0 || curve.numKeys < 3 || !isReducible(curve))
+		return false;
+
+	// Douglas-Peucker on the key values, a segment is split at its worst key until every removed key is within the tolerance
+	vector<bool> isKept(curve.numKeys, false);
+	isKept.front() = isKept.back() = true;
+
+	vector<pair<size_t, size_t>> segments;
+	segments.push_back(make_pair(0, curve.numKeys - 1));
+
+	while (!segments.empty())
+	{
+		const size_t first = segments.back().first;
+		const size_t last = segments.back().second;
+		segments.pop_back();
+
+		const double t0 = curve.times[first];
+		const double v0 = curve.values[first];
+		const double slope = (curve.values[last] - v0) / (curve.times[last] - t0);
+
+		size_t worst = first;
+		double worstError = 0;
+		for (size_t i = first + 1; i < last; i++)
+		{
+			const double error = fabs(curve.values[i] - (v0 + slope * (curve.times[i] - t0)));
+			if (error > worstError)
+			{
+				worst = i;
+				worstError = error;
+			}
+		}
+
+		if (worstError > tolerance)
+		{
+			isKept[worst] = true;
+			segments.push_back(make_pair(first, worst));
+			segments.push_back(make_pair(worst, last));
+		}
+		else
+			maxError = max(maxError, worstError);
+	}
+
+	// linear keys would only change the shape of spline curves between their keys
+	if ((size_t)count(isKept.begin(), isKept.end(), true) == curve.numKeys)
+	{
+		maxError = 0;
+		return false;
+	}
+
+	for (size_t i = 0; i < curve.numKeys; i++)
+	{
+		if (!isKept[i])
+			continue;
+
+		keys.times.push_back(curve.times[i]);
+		keys.values.push_back(curve.values[i]);
+		keys.inTangentTypes.push_back(TangentLinear);
+		keys.outTangentTypes.push_back(TangentLinear);
+	}
+
+	reduced = curve;
+	reduced.setKeys(keys);
+	return true;
+}
+
+void reduceCurves(vector<ReductionJob> &jobs, const CurveTolerances &tolerances)
+{
+	size_t numKeys = 0;
+	for (const auto &job : jobs)
+		numKeys += job.curve->numKeys;
+
+	parallelFor(jobs.size(), getNumThreads(jobs.size(), numKeys, 10000), [&](size_t i)
+	{
+		ReductionJob &job = jobs[i];
+		job.isReduced = reduceCurve(*job.curve, tolerances.get(job.animCurveType), job.keys, job.result, job.maxError);
+		if (!job.isReduced)
+			job.result = *job.curve;
+	});
+}
+
+const size_t ChannelReducer::NoJob;
+
+void ChannelReducer::add(const ChannelData &channel, int animCurveType)
+{
+	m_channels.push_back(channel);
+	m_animCurveTypes.push_back(animCurveType);
+	m_jobs.push_back(NoJob);
+}
+
+void ChannelReducer::reduce(const CurveTolerances &tolerances)
+{
+	m_keys.clear();
+	m_curves.clear();
+	m_reductionJobs.clear();
+
+	for (size_t i = 0; i < m_channels.size(); i++)
+	{
+		m_jobs[i] = NoJob;
+		if (tolerances.get(m_animCurveTypes[i]) <= 0)
+			continue;
+
+		m_keys.emplace_back();
+		m_curves.emplace_back();
+		getChannelCurveData(m_channels[i], m_keys.back(), m_curves.back());
+
+		m_jobs[i] = m_reductionJobs.size();
+		m_reductionJobs.emplace_back();
+		m_reductionJobs.back().curve = &m_curves.back();
+		m_reductionJobs.back().animCurveType = m_animCurveTypes[i];
+	}
+
+	reduceCurves(m_reductionJobs, tolerances);
+}
+
+const ReductionJob* ChannelReducer::reduced(size_t i) const
+{
+	if (m_jobs[i] == NoJob)
+		return nullptr;
+
+	const ReductionJob &job = m_reductionJobs[m_jobs[i]];
+	return job.isReduced && job.result.numKeys * 2 <= m_channels[i].numValues ? &job : nullptr;
+}
+
+void ChannelReducer::clear()
+{
+	m_channels.clear();
+	m_animCurveTypes.clear();
+	m_jobs.clear();
+	m_keys.clear();
+	m_curves.clear();
+	m_reductionJobs.clear();
+}
+
+void ReductionStats::add(const CurveData &curve, const CurveData &result, int animCurveType, double error)
+{
+	curves++;
+	keysBefore += curve.numKeys;
+	keysAfter += result.numKeys;
+
+	double &kindError = maxError[getToleranceKind(animCurveType)];
+	kindError = max(kindError, error);
+}
+
+string ReductionStats::toString() const
+{
+	char str[256];
+	snprintf(str, sizeof(str), "Reduced %zu curves from %zu to %zu keys, max error: angular %g, linear %g, unitless %g",
+		curves, keysBefore, keysAfter, maxError[0], maxError[1], maxError[2]);
+	return str;
+}
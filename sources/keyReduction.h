@@ -0,0 +1,77 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "clip.h"
+
+using namespace std;
+
+// Removes keys which the linear interpolation of the kept keys reproduces within the tolerance. The first and the last keys are kept
+// and the kept keys get linear tangents, so the error is exact at the original key times. Only curves with linear tangents
+// or with a key at least every frame are reduced, curves with fixed or stepped tangents never are.
+// Returns false and leaves the output empty when the curve is not reduced.
+bool reduceCurve(const CurveData &curve, double tolerance, CurveKeys &keys, CurveData &reduced, double &maxError);
+
+// A curve is constant when its key values are within the tolerance of the returned value and no tangent or infinity leaves it.
+// Fixed tangents have to be flat, linear and cycle relative infinities are only allowed when the values are exactly equal.
+bool isConstantCurve(const CurveData &curve, double tolerance, double &value);
+bool isConstantChannel(const ChannelData &channel, double tolerance, double &value);
+
+// curve reduced by reduceCurves, the result points to the job's own keys
+struct ReductionJob
+{
+	const CurveData *curve = nullptr;
+	int animCurveType = 0;
+
+	CurveKeys keys;
+	CurveData result;
+	double maxError = 0;
+	bool isReduced = false;
+};
+
+// reduces the curves in parallel, curves without a tolerance for their type are left as they are
+void reduceCurves(vector<ReductionJob> &jobs, const CurveTolerances &tolerances);
+
+// Reduces the baked channels of a node as curves with linear keys at their samples. Only channels whose type has a tolerance are
+// reduced, and a reduced curve, which stores times and tangent types with its values, replaces its channel only when it
+// keeps at most half the samples. The other channels keep the channel encoding.
+class ChannelReducer
+{
+public:
+	// the channel values are used in place
+	void add(const ChannelData &channel, int animCurveType);
+	void reduce(const CurveTolerances &tolerances);
+	void clear();
+
+	size_t size() const { return m_channels.size(); }
+	const ChannelData& channel(size_t i) const { return m_channels[i]; }
+	int animCurveType(size_t i) const { return m_animCurveTypes[i]; }
+
+	// the curve written in place of a channel, null when the channel is written as it is
+	const ReductionJob* reduced(size_t i) const;
+
+private:
+	static const size_t NoJob = SIZE_MAX;
+
+	vector<ChannelData> m_channels;
+	vector<int> m_animCurveTypes;
+	vector<size_t> m_jobs; // per channel
+
+	deque<CurveKeys> m_keys;
+	deque<CurveData> m_curves;
+	vector<ReductionJob> m_reductionJobs;
+};
+
+// totals of a reduction pass
+struct ReductionStats
+{
+	size_t curves = 0;
+	size_t keysBefore = 0;
+	size_t keysAfter = 0;
+	double maxError[3] = {}; // angular, linear, unitless
+
+	void add(const CurveData &curve, const CurveData &result, int animCurveType, double maxError);
+	string toString() const;
+};
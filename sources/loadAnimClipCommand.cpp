@@ -1,5 +1,6 @@
 #include <maya/MGlobal.h>
 #include <maya/MDoubleArray.h>
+#include <maya/MTimeArray.h>
 #include <maya/MSelectionList.h>
 #include <maya/MPlug.h>
 #include <maya/MPlugArray.h>
@@ -8,32 +9,53 @@
 #include <maya/MAnimControl.h>
 #include <maya/MFnAnimCurve.h>
 #include <maya/MFnDependencyNode.h>
+#include <maya/MFnDagNode.h>
 #include <maya/MArgDatabase.h>
 #include <maya/MArgList.h>
 #include <maya/MArgParser.h>
+#include <maya/MFnStringArrayData.h>
+#include <maya/MFnDoubleArrayData.h>
+#include <maya/MStringArray.h>
 
+#include <cmath>
 #include <vector>
 #include <set>
-#include <string>
 #include <fstream>
-
-#include "rapidjson/document.h"
-#include "rapidjson/istreamwrapper.h"
-#include "rapidjson/writer.h"
+#include <sstream>
+#include <unordered_map>
+#include <string>
+#include <memory>
 
 #include "utils.h"
+#include "clip.h"
+#include "keyReduction.h"
+#include "curvePaste.h"
 
 #include "loadAnimClipCommand.h"
+#include "animClipCacheCommand.h"
+#include "animClipPlayerNode.h"
+#include "applyPlan.h"
 
 using namespace std;
-using namespace rapidjson;
 
 MSyntax LoadAnimClipCommand::newSyntax()
 {
 	MSyntax syntax;
 	syntax.addFlag("-ns", "-namespace", MSyntax::MArgType::kString);
+	syntax.addFlag("-to", "-timeOffset", MSyntax::MArgType::kDouble);
+	syntax.addFlag("-nsf", "-namespaceFile", MSyntax::MArgType::kString);
 	syntax.addFlag("-f", "-file", MSyntax::MArgType::kString);
 	syntax.addFlag("-sf", "-startFrame", MSyntax::MArgType::kLong);
+	syntax.addFlag("-p", "-profile");
+	syntax.addFlag("-pf", "-profileFile", MSyntax::MArgType::kString);
+	syntax.addFlag("-nc", "-noCache");
+	syntax.addFlag("-fc", "-foldConstant");
+	syntax.addFlag("-pl", "-player");
+	syntax.addFlag("-pm", "-pasteMode", MSyntax::MArgType::kString);
+	syntax.addFlag("-ul", "-undoLimit", MSyntax::MArgType::kDouble);
+	addToleranceFlags(syntax, "-rd", "-reduce");
+	syntax.makeFlagMultiUse("-ns");
+	syntax.makeFlagMultiUse("-to");
 	syntax.setObjectType(MSyntax::kSelectionList, 0);
 	syntax.useSelectionAsDefault(true);
 
@@ -43,6 +65,7 @@ MSyntax LoadAnimClipCommand::newSyntax()
 MStatus LoadAnimClipCommand::doIt(const MArgList& args)
 {
 	MArgDatabase argData(newSyntax(), args);
+	m_isUndoable = false;
 
 	if (!argData.isFlagSet("-f"))
 	{
@@ -50,8 +73,40 @@ MStatus LoadAnimClipCommand::doIt(const MArgList& args)
 		return MS::kFailure;
 	}
 
-	if (argData.isFlagSet("-ns"))
-		argData.getFlagArgument("-ns", 0, m_namespace);
+	// the i-th time offset goes with the i-th namespace
+	const unsigned int numOffsets = argData.numberOfFlagUses("-to");
+	for (unsigned int i = 0; i < argData.numberOfFlagUses("-ns"); i++)
+	{
+		MArgList nsArgs;
+		argData.getFlagArgumentList("-ns", i, nsArgs);
+
+		double timeOffset = 0;
+		if (i < numOffsets)
+		{
+			MArgList offsetArgs;
+			argData.getFlagArgumentList("-to", i, offsetArgs);
+			timeOffset = offsetArgs.asDouble(0);
+		}
+
+		m_namespaces.push_back({ nsArgs.asString(0).asChar(), timeOffset });
+	}
+
+	if (argData.isFlagSet("-nsf"))
+	{
+		MString namespaceFile;
+		argData.getFlagArgument("-nsf", 0, namespaceFile);
+		if (!readNamespaceFile(namespaceFile))
+		{
+			MGlobal::displayError("Cannot read namespace file '" + namespaceFile + "'");
+			return MS::kFailure;
+		}
+	}
+
+	for (auto &ns : m_namespaces)
+	{
+		if (!ns.name.empty() && ns.name.back() != ':')
+			ns.name += ':';
+	}
 
 	argData.getFlagArgument("-f", 0, m_filePath);
 
@@ -60,219 +115,570 @@ MStatus LoadAnimClipCommand::doIt(const MArgList& args)
 	else
 		m_startFrame = DBL_MAX;
 
+	if (argData.isFlagSet("-pf"))
+		argData.getFlagArgument("-pf", 0, m_profileFile);
+
+	m_useCache = !argData.isFlagSet("-nc");
+	m_foldConstant = argData.isFlagSet("-fc");
+	m_usePlayer = argData.isFlagSet("-pl");
+
+	m_pasteMode = PasteMerge;
+	if (argData.isFlagSet("-pm"))
+	{
+		MString pasteMode;
+		argData.getFlagArgument("-pm", 0, pasteMode);
+		m_pasteMode = findPasteMode(pasteMode.asChar());
+		if (m_pasteMode < 0)
+		{
+			MGlobal::displayError("-pasteMode(-pm) must be merge, replace or insert");
+			return MS::kFailure;
+		}
+	}
+	m_reduction = getTolerances(argData, "-rd");
+
+	// megabytes of keys kept for undo, no undo with 0
+	m_journal.setLimit(SIZE_MAX);
+	if (argData.isFlagSet("-ul"))
+	{
+		double undoLimit;
+		argData.getFlagArgument("-ul", 0, undoLimit);
+		m_journal.setLimit((size_t)(max(undoLimit, 0.0) * 1024 * 1024));
+	}
+
+	m_profiler.setEnabled(argData.isFlagSet("-p") || argData.isFlagSet("-pf"));
+
+	// given or selected nodes take precedence over namespaces, as they always did
 	argData.getObjects(m_objectList);
+	if (m_objectList.length() > 0 && !m_namespaces.empty())
+	{
+		MGlobal::displayWarning("Namespaces are ignored, the clip is applied to the given or selected nodes");
+		m_namespaces.clear();
+	}
 
-	redoIt();
-	return MS::kSuccess;
+	return apply();
+}
+
+// every line is a namespace optionally followed by a time offset, empty lines and lines starting with # are skipped
+bool LoadAnimClipCommand::readNamespaceFile(const MString &filePath)
+{
+	ifstream file(filePath.asChar());
+	if (!file.good())
+		return false;
+
+	string line;
+	while (getline(file, line))
+	{
+		istringstream stream(line);
+
+		NamespaceTarget ns = { "", 0 };
+		if (!(stream >> ns.name) || ns.name[0] == '#')
+			continue;
+
+		stream >> ns.timeOffset;
+		m_namespaces.push_back(ns);
+	}
+
+	return true;
 }
 
-MObject getMObjectByName(const MString& name)
+static double toUnit(double t, MTime::Unit from, MTime::Unit to)
 {
-	MSelectionList selList;
-	selList.add(name);
+	return from == to || fabs(t) == DBL_MAX ? t : MTime(t, from).as(to);
+}
+
+// frames of a curve in its own unit the keys change, every frame of a curve without time input or keys
+static void getCurvePasteRange(const MFnAnimCurve& acFn, const CurveData& curve, double timeOffset, int pasteMode, double &start, double &end)
+{
+	getPasteRange(curve, timeOffset, pasteMode, start, end);
+	if (curve.numKeys == 0)
+		return;
+
+	if (!acFn.isTimeInput() || acFn.numKeys() == 0)
+	{
+		start = -DBL_MAX;
+		end = DBL_MAX;
+		return;
+	}
 
-	MObject object;
-	if (selList.length() > 0)
-		selList.getDependNode(0, object);
-	return object;
+	const auto unit = (MTime::Unit)curve.unit;
+	const auto curveUnit = acFn.time(0).unit();
+	start = toUnit(start, unit, curveUnit);
+	end = toUnit(end, unit, curveUnit);
 }
 
-void setAnimCurveData(MFnAnimCurve& acFn, const Value& animData, MAnimCurveChange *animChange, double timeOffset = 0)
+// Keys of the paste range of a time curve are read, merged with the pasted keys off the DG and written back with a single
+// call replacing that range
+void pasteAnimCurveData(MFnAnimCurve& acFn, const CurveData& curve, MAnimCurveChange *animChange, double timeOffset, int pasteMode,
+	CurveKeys &existingKeys, CurveKeys &pastedKeys)
 {
-	const double coeff = acFn.animCurveType() == MFnAnimCurve::AnimCurveType::kAnimCurveTA || // degrees to radians
-						 acFn.animCurveType() == MFnAnimCurve::AnimCurveType::kAnimCurveUA ? 0.0174532862 : 1;
+	const auto unit = (MTime::Unit)curve.unit;
+	const auto curveUnit = acFn.time(0).unit();
+
+	double start, end;
+	getCurvePasteRange(acFn, curve, timeOffset, pasteMode, start, end);
 
-	const bool isWeighted = animData["weighted"].GetBool();
-	acFn.setIsWeighted(isWeighted);
+	getAnimCurveFrameData(acFn, existingKeys, start, end);
+	for (auto &t : existingKeys.times)
+		t = toUnit(t, curveUnit, unit);
 
-	const auto unit = (MTime::Unit)animData["unit"].GetInt();
+	CurveData existing;
+	existing.setKeys(existingKeys);
+	pasteKeys(existing, curve, timeOffset, pasteMode, pastedKeys);
 
-	for (const auto& frameData : animData["data"].GetArray())
+	CurveData pasted = curve;
+	pasted.setKeys(pastedKeys);
+	setAnimCurveData(acFn, pasted, animChange, 0, false);
+}
+
+void LoadAnimClipCommand::resolveNode(const Clip &clip, const MObject &nodeObj, size_t group, AnimCurveIndex &curveIndex, ApplyPlan &plan)
+{
+	curveIndex.addNode(nodeObj);
+
+	MFnDependencyNode nodeFn(nodeObj);
+	const string nodeLocalName = getNodeLocalName(nodeFn);
+
+	const ClipNode *clipNode = clip.findNode(nodeLocalName);
+	if (!clipNode)
 	{
-		const auto &fdata = frameData.GetArray();
-		const double t(fdata[0].GetDouble());
-		const double v(fdata[1].GetDouble());
-		const auto itt = TangentTypesMap.at(fdata[2].GetString());
-		const auto ott = TangentTypesMap.at(fdata[3].GetString());
+		const string mirrorName = getMirrorName(nodeLocalName);
+		if (!mirrorName.empty())
+			clipNode = clip.findNode(mirrorName);
+
+		if (!clipNode)
+		{
+			plan.warnings.push_back("Cannot find '" + MString(nodeLocalName.c_str()) + "' in clip");
+			return;
+		}
+	}
 
-		const double time = t + timeOffset;
-		const double value = v * coeff;
+	const MString node(clipNode->name);
+	plan.nodes.push_back(nodeObj);
 
-		int idx;
-		if (acFn.isTimeInput())
-			idx = acFn.addKey(MTime(time, unit), value, MFnAnimCurve::TangentType::kTangentGlobal, MFnAnimCurve::TangentType::kTangentGlobal, animChange);
-		else
-			idx = acFn.addKey(time, value, MFnAnimCurve::TangentType::kTangentGlobal, MFnAnimCurve::TangentType::kTangentGlobal, animChange);
-		
-		if (itt == MFnAnimCurve::kTangentFixed || ott == MFnAnimCurve::kTangentFixed)
+	// attribute names are converted once per clip, not once per node and namespace
+	auto getAttrName = [&](uint32_t attrId) -> const MString&
+	{
+		MString &attrName = m_attrNames[attrId];
+		if (attrName.length() == 0)
+			attrName = clip.names().get(attrId);
+		return attrName;
+	};
+
+	auto addTarget = [&](uint32_t attrId, const CurveData *curve, const ChannelData *channel, const ClipStatic *staticValue)
+	{
+		const MString &attrName = getAttrName(attrId);
+		MPlug destPlug = nodeFn.findPlug(attrName, true);
+		if (destPlug.isNull())
 		{
-			const bool wl = fdata[4].GetBool();
-			const bool tl = fdata[5].GetBool();
-			const MAngle ia(fdata[6].GetDouble());
-			const MAngle oa(fdata[7].GetDouble());
-			const double iw(fdata[8].GetDouble());
-			const double ow(fdata[9].GetDouble());
-
-			acFn.setWeightsLocked(idx, false);
-			acFn.setTangentsLocked(idx, false);
-			acFn.setTangent(idx, ia, iw, true);
-			acFn.setTangent(idx, oa, ow, false);
-
-			if (isWeighted)
-			{
-				const double ix(fdata[10].GetDouble());
-				const double iy(fdata[11].GetDouble());
-				const double ox(fdata[12].GetDouble());
-				const double oy(fdata[13].GetDouble());
-				acFn.setTangent(idx, ix, iy, true);
-				acFn.setTangent(idx, ox, oy, false);
-			}
-
-			acFn.setWeightsLocked(idx, wl);
-			acFn.setTangentsLocked(idx, tl);
+			plan.warnings.push_back("Cannot find '" + nodeFn.name() + "." + attrName + "'");
+			return;
 		}
 
-		acFn.setInTangentType(idx, itt);
-		acFn.setOutTangentType(idx, ott);
+		const MObject animCurve = staticValue ? MObject() : curveIndex.find(destPlug);
+		plan.targets.push_back({ nodeObj, destPlug, animCurve, node, attrName, group, curve, channel, staticValue });
+	};
+
+	for (const auto &data : clipNode->curves) // per every animation curve data
+		addTarget(data.attrId, &data.data, nullptr, nullptr);
+
+	for (const auto &data : clipNode->channels) // per every baked channel
+		addTarget(data.attrId, nullptr, &data.data, nullptr);
+
+	for (const auto &data : clipNode->statics) // per every static attribute
+		addTarget(data.attrId, nullptr, nullptr, &data);
+}
+
+MObject LoadAnimClipCommand::applyTarget(const ApplyPlan::Target &target, double startFrame, Profiler::Timer &timer)
+{
+	timer.start("resolution");
+
+	MPlug destPlug = target.plug; // a copy, timedAnimCurveTypeForPlug takes a non-const plug
+
+	// locking does not change the graph, so it is checked on every application
+	if (destPlug.isLocked())
+		return MObject();
+
+	if (target.staticValue)
+	{
+		m_dgmod.newPlugValueDouble(destPlug, target.staticValue->value);
+		m_profiler.addCount("statics", 1);
+		return MObject();
+	}
+
+	const CurveData *curveData = target.curve;
+	if (target.channel)
+	{
+		timer.start("keyInsertion");
+		getChannelCurveData(*target.channel, m_channelKeys, m_channelCurve);
+		curveData = &m_channelCurve;
+		m_profiler.addCount("channels", 1);
+	}
+
+	const CurveData &curve = *curveData;
+
+	// the curve type, and so the tolerance, is known once the target curve exists
+	auto reduceCurveData = [&](const MFnAnimCurve &acFn) -> const CurveData&
+	{
+		const int animCurveType = (int)acFn.animCurveType();
+		const double tolerance = m_reduction.get(animCurveType);
+		if (tolerance <= 0)
+			return curve;
+
+		timer.start("reduction");
+
+		double maxError = 0;
+		if (!reduceCurve(curve, tolerance, m_reducedKeys, m_reducedCurve, maxError))
+			return curve;
+
+		m_reductionStats.add(curve, m_reducedCurve, animCurveType, maxError);
+		return m_reducedCurve;
+	};
+
+	// a constant curve on a plug without a curve only sets its value
+	if (target.animCurve.isNull() && m_foldConstant)
+	{
+		const int animCurveType = (int)MFnAnimCurve().timedAnimCurveTypeForPlug(destPlug);
+
+		double value;
+		if (isConstantCurve(curve, m_reduction.get(animCurveType), value))
+		{
+			m_dgmod.newPlugValueDouble(destPlug, isAngularCurveType(animCurveType) ? value * DegreesToRadians : value);
+			m_profiler.addCount("foldedStatics", 1);
+			return MObject();
+		}
 	}
+
+	// the player drives the plug in place of its curve, curves it cannot evaluate like Maya get an animCurve
+	if (m_usePlayer && !canEvaluate(curve))
+		m_profiler.addCount("playerFallbacks", 1);
+	else if (m_usePlayer)
+	{
+		const int animCurveType = (int)MFnAnimCurve().timedAnimCurveTypeForPlug(destPlug);
+		const MObject output = isAngularCurveType(animCurveType) ? AnimClipPlayerNode::outputAngular :
+			animCurveType == MFnAnimCurve::kAnimCurveTL ? AnimClipPlayerNode::outputLinear : AnimClipPlayerNode::outputUnitless;
+
+		const MPlug source = destPlug.source();
+		if (!source.isNull())
+			m_dgmod.disconnect(source, destPlug);
+
+		m_playerTargets.push_back({ target.clipNode + "." + target.attr, destPlug, output, destPlug.asDouble() });
+		m_profiler.addCount("playerChannels", 1);
+		return MObject();
+	}
+
+	MObject ac;
+	if (target.animCurve.isNull())
+	{
+		timer.start("curveCreation");
+		MFnAnimCurve acFn;
+		ac = acFn.create(target.node, destPlug.attribute(), &m_dgmod);
+		m_dgmod.renameNode(ac, target.clipNode + "_" + target.attr);
+
+		acFn.setPreInfinityType((MFnAnimCurve::InfinityType)curve.preInfinity);
+		acFn.setPostInfinityType((MFnAnimCurve::InfinityType)curve.postInfinity);
+
+		timer.start("keyInsertion");
+		const CurveData &keys = reduceCurveData(acFn);
+		setAnimCurveData(acFn, keys, NULL, startFrame);
+		m_journal.addCreated(ac);
+		m_profiler.addCount("keys", keys.numKeys);
+	}
+	else
+	{
+		MFnAnimCurve acFn(target.animCurve);
+		const CurveData &keys = reduceCurveData(acFn);
+		timer.start("undoRecording");
+		double start, end;
+		getCurvePasteRange(acFn, keys, startFrame, m_pasteMode, start, end);
+		m_journal.recordBefore(target.animCurve, start, end, keys.weighted);
+
+		timer.start("keyInsertion");
+		if (acFn.isTimeInput() && acFn.numKeys() > 0 && keys.numKeys > 0)
+			pasteAnimCurveData(acFn, keys, NULL, startFrame, m_pasteMode, m_existingKeys, m_pastedKeys);
+		else
+			setAnimCurveData(acFn, keys, NULL, startFrame);
+		m_profiler.addCount("keys", keys.numKeys);
+	}
+
+	m_profiler.addCount("curves", 1);
+	return ac;
 }
 
-MStatus LoadAnimClipCommand::redoIt()
+// one player drives the targets of a namespace or of the selection
+void LoadAnimClipCommand::createPlayer(const MString &ns, double startFrame)
 {
-	const double currentFrame = m_startFrame == DBL_MAX ? MAnimControl::currentTime().value() : m_startFrame;
+	if (m_playerTargets.empty())
+		return;
+
+	MObject player = m_dgmod.createNode(AnimClipPlayerNode::id);
+	m_dgmod.renameNode(player, ns + "animClipPlayer");
 
-	ifstream ifs(m_filePath.asChar());
-	if (!ifs.good())
+	MStringArray channels;
+	MDoubleArray rest;
+	for (const auto &target : m_playerTargets)
 	{
-		MGlobal::displayError("Cannot open file '" + m_filePath + "'");
-		return MS::kFailure;
+		channels.append(target.channel);
+		rest.append(target.rest);
 	}
-	IStreamWrapper isw(ifs);
 
-	Document doc;
-	doc.ParseStream(isw);
+	MFnDependencyNode playerFn(player);
+
+	MObject channelsData = MFnStringArrayData().create(channels);
+	MObject restData = MFnDoubleArrayData().create(rest);
+	m_dgmod.newPlugValueString(playerFn.findPlug(AnimClipPlayerNode::file, true), m_filePath);
+	m_dgmod.newPlugValue(playerFn.findPlug(AnimClipPlayerNode::channels, true), channelsData);
+	m_dgmod.newPlugValue(playerFn.findPlug(AnimClipPlayerNode::rest, true), restData);
+	m_dgmod.newPlugValueDouble(playerFn.findPlug(AnimClipPlayerNode::offset, true), startFrame);
+
+	MSelectionList timeList;
+	MObject timeNode;
+	if (timeList.add("time1") == MS::kSuccess && timeList.getDependNode(0, timeNode) == MS::kSuccess)
+		m_dgmod.connect(MFnDependencyNode(timeNode).findPlug("outTime", true), playerFn.findPlug(AnimClipPlayerNode::time, true));
+
+	for (unsigned int i = 0; i < (unsigned int)m_playerTargets.size(); i++)
+		m_dgmod.connect(playerFn.findPlug(m_playerTargets[i].output, true).elementByLogicalIndex(i), m_playerTargets[i].plug);
 
-	if (m_objectList.length() == 0) // use all objects in the clip
+	m_profiler.addCount("players", 1);
+	m_playerTargets.clear();
+}
+
+// Plans are made per file and per namespaces, or per selected nodes. Nodes are named by path and uuid: references of the
+// same file share uuids, and a reparented node may take the path another node had.
+string LoadAnimClipCommand::getPlanKey(const vector<NamespaceTarget> &namespaces) const
+{
+	string key = m_filePath.asChar();
+	for (const auto &ns : namespaces)
+		key += "\nns " + ns.name;
+
+	if (namespaces.empty())
 	{
-		for (auto it = doc.MemberBegin(); it != doc.MemberEnd(); it++)
+		for (int i = 0; i < m_objectList.length(); i++)
 		{
-			MString nodeName = m_namespace + it->name.GetString();
-			MObject nodeObj = getMObjectByName(nodeName);
-			if (!nodeObj.isNull())
-				m_objectList.add(nodeObj);
-			else
-				MGlobal::displayWarning("Cannot find '" + nodeName + "' in the scene");
+			MObject nodeObj;
+			m_objectList.getDependNode(i, nodeObj);
+			const MFnDependencyNode nodeFn(nodeObj);
+			const MString path = nodeObj.hasFn(MFn::kDagNode) ? MFnDagNode(nodeObj).fullPathName() : nodeFn.name();
+			key += string("\nnode ") + path.asChar() + " " + nodeFn.uuid().asString().asChar();
 		}
 	}
 
-	for (int i = 0; i < m_objectList.length(); i++)
+	return key;
+}
+
+shared_ptr<ApplyPlan> LoadAnimClipCommand::makePlan(const vector<NamespaceTarget> &namespaces, Profiler::Timer &timer)
+{
+	timer.start("resolution");
+
+	// only clip nodes which can be applied are decoded, the cache keeps the clip by the names its filter accepts
+	ClipNodeFilter filter;
+	set<string> acceptedNames; // sorted, so the filter key does not depend on the scene order
+
+	vector<string> namespaceNames;
+	for (const auto &ns : namespaces)
+		namespaceNames.push_back(ns.name);
+
+	vector<unordered_map<string, MObject>> sceneNodes;
+
+	// namespaces are looked up in a single scene pass
+	if (!namespaces.empty())
 	{
-		MObject nodeObj;
-		m_objectList.getDependNode(i, nodeObj);
+		sceneNodes = getNamespaceNodes(namespaceNames);
 
-		MFnDependencyNode nodeFn(nodeObj);
-		string nodeLocalName = getNodeLocalName(nodeFn);
+		for (const auto &nodes : sceneNodes)
+		{
+			for (const auto &node : nodes)
+				acceptedNames.insert(node.first);
+		}
 
-		if (!doc.HasMember(nodeLocalName.c_str()))
+		filter = [&](const char *name) { return acceptedNames.count(name) > 0; };
+	}
+	else
+	{
+		for (int i = 0; i < m_objectList.length(); i++)
 		{
-			string mirrorName;
-			if (startsWith(nodeLocalName, "L_"))
-				mirrorName = "R_"+ nodeLocalName.substr(2);
+			MObject nodeObj;
+			m_objectList.getDependNode(i, nodeObj);
 
-			else if (startsWith(nodeLocalName, "R_"))
-				mirrorName = "L_" + nodeLocalName.substr(2);
+			const string nodeLocalName = getNodeLocalName(MFnDependencyNode(nodeObj));
+			acceptedNames.insert(nodeLocalName);
+			acceptedNames.insert(getMirrorName(nodeLocalName));
+		}
 
-			else if (startsWith(nodeLocalName, "l_"))
-				mirrorName = "r_" + nodeLocalName.substr(2);
+		filter = [&](const char *name) { return acceptedNames.count(name) > 0; };
+	}
 
-			else if (startsWith(nodeLocalName, "r_"))
-				mirrorName = "l_" + nodeLocalName.substr(2);
+	string filterKey;
+	for (const auto &name : acceptedNames)
+		filterKey += name + "\n";
 
-			else if (endsWith(nodeLocalName, "_L"))
-				mirrorName = nodeLocalName.substr(0, nodeLocalName.length()-2) + "_R";
+	timer.stop();
 
-			else if (endsWith(nodeLocalName, "_R"))
-				mirrorName = nodeLocalName.substr(0, nodeLocalName.length() - 2) + "_L";
+	string error;
+	shared_ptr<const Clip> clipPtr;
+	if (m_useCache)
+		clipPtr = getClipCache().load(m_filePath.asChar(), error, &m_profiler, filter, filterKey);
+	else
+	{
+		shared_ptr<Clip> loadedClip = make_shared<Clip>();
+		if (loadedClip->load(m_filePath.asChar(), error, &m_profiler, filter))
+			clipPtr = loadedClip;
+	}
 
-			else if (endsWith(nodeLocalName, "_l"))
-				mirrorName = nodeLocalName.substr(0, nodeLocalName.length() - 2) + "_r";
+	if (!clipPtr)
+	{
+		MGlobal::displayError(error.c_str());
+		return nullptr;
+	}
+
+	// the clip is decoded once and resolved for every namespace
+	const Clip &clip = *clipPtr;
+	m_attrNames.assign(clip.names().size(), MString());
 
-			else if (endsWith(nodeLocalName, "_r"))
-				mirrorName = nodeLocalName.substr(0, nodeLocalName.length() - 2) + "_l";
+	shared_ptr<ApplyPlan> plan = make_shared<ApplyPlan>();
+	plan->clip = clipPtr;
+	plan->filterKey = filterKey;
 
-			if (!doc.HasMember(mirrorName.c_str()))
-			{
-				MGlobal::displayWarning("Cannot find '" + MString(nodeLocalName.c_str()) + "' in clip");
-				continue;
-			}
+	timer.start("resolution");
 
-			nodeLocalName = mirrorName;
+	AnimCurveIndex curveIndex;
+
+	if (namespaces.empty())
+	{
+		for (int i = 0; i < m_objectList.length(); i++)
+		{
+			MObject nodeObj;
+			m_objectList.getDependNode(i, nodeObj);
+			resolveNode(clip, nodeObj, 0, curveIndex, *plan);
 		}
+	}
+
+	for (size_t n = 0; n < namespaces.size(); n++)
+	{
+		const MString ns(namespaces[n].name.c_str());
+		const auto &nodes = sceneNodes[n];
 
-		const char *node = nodeLocalName.c_str();
+		for (const auto &name : clip.skippedNodes()) // not in any of the namespaces
+			plan->warnings.push_back("Cannot find '" + ns + name.c_str() + "' in the scene");
 
-		for (const auto &data : doc[node]["animation"].GetObject()) // per every animation curve data
+		for (const auto &clipNode : clip.nodes())
 		{
-			const MString attrName(data.name.GetString());
-
-			MPlug destPlug = nodeFn.findPlug(attrName, true);
-			if (destPlug.isNull())
-			{
-				MGlobal::displayWarning("Cannot find '" + nodeFn.name() + "." + attrName + "'");
-				continue;
-			}
-
-			if (!destPlug.isLocked())
-			{
-				MObjectArray animCurves;
-				findAnimationCurves(destPlug, animCurves);
-
-				if (animCurves.length() == 0)
-				{
-					MFnAnimCurve acFn;
-					MObject ac = acFn.create(nodeObj, destPlug.attribute(), &m_dgmod);
-					m_dgmod.renameNode(ac, MString(node) + "_"+ attrName);
-
-					acFn.setPreInfinityType((MFnAnimCurve::InfinityType)data.value["preinf"].GetInt());
-					acFn.setPostInfinityType((MFnAnimCurve::InfinityType)data.value["postinf"].GetInt());
-
-					setAnimCurveData(acFn, data.value, NULL, currentFrame);
-				}
-				else
-				{
-					for (int k = 0; k < animCurves.length(); k++)
-						setAnimCurveData(MFnAnimCurve(animCurves[k]), data.value, &m_animChange, currentFrame);
-				}
-			}
+			const auto found = nodes.find(clipNode.name);
+			if (found != nodes.end())
+				resolveNode(clip, found->second, n, curveIndex, *plan);
+			else
+				plan->warnings.push_back("Cannot find '" + ns + clipNode.name + "' in the scene");
 		}
+	}
+
+	timer.stop();
+	return plan;
+}
+
+MStatus LoadAnimClipCommand::apply()
+{
+	const double currentFrame = m_startFrame == DBL_MAX ? MAnimControl::currentTime().value() : m_startFrame;
 
-		for (const auto &attrData : doc[node]["static"].GetObject()) // per every static attribute
+	m_profiler.clear();
+	m_reductionStats = ReductionStats();
+
+	Profiler::Timer timer(m_profiler);
+
+	// the root namespace is used without namespaces or selection
+	vector<NamespaceTarget> namespaces = m_namespaces;
+	if (namespaces.empty() && m_objectList.length() == 0)
+		namespaces.push_back({ "", 0 });
+
+	// the plan of an earlier load is reused while the scene graph and the clip file are unchanged
+	const string planKey = getPlanKey(namespaces);
+	shared_ptr<const ApplyPlan> plan;
+	if (m_useCache)
+	{
+		shared_ptr<const ApplyPlan> cachedPlan = getApplyPlanCache().find(planKey);
+		if (cachedPlan && getClipCache().find(m_filePath.asChar(), cachedPlan->filterKey) == cachedPlan->clip)
 		{
-			const MString attrName(attrData.name.GetString());
-			MPlug destPlug = nodeFn.findPlug(attrName, true);
-			if (destPlug.isNull())
-			{
-				MGlobal::displayWarning("Cannot find '" + nodeFn.name() + "." + attrName + "'");
-				continue;
-			}
-
-			if (!destPlug.isLocked())
-				m_dgmod.newPlugValueDouble(destPlug, attrData.value.GetDouble());
+			plan = cachedPlan;
+			m_profiler.addCount("planHits", 1);
 		}
 	}
 
+	shared_ptr<ApplyPlan> newPlan;
+	if (!plan)
+	{
+		newPlan = makePlan(namespaces, timer);
+		if (!newPlan)
+			return MS::kFailure;
+		plan = newPlan;
+	}
+
+	for (const auto &warning : plan->warnings)
+		MGlobal::displayWarning(warning);
+
+	m_profiler.addCount("nodes", plan->nodes.size());
+
+	// targets are ordered by namespace, a player is made for each
+	const vector<ApplyPlan::Target> &targets = plan->targets;
+	vector<pair<size_t, MObject>> createdCurves; // by target
+	size_t next = 0;
+	for (size_t group = 0; group < max<size_t>(namespaces.size(), 1); group++)
+	{
+		const double startFrame = currentFrame + (group < namespaces.size() ? namespaces[group].timeOffset : 0);
+
+		for (; next < targets.size() && targets[next].group == group; next++)
+		{
+			const MObject animCurve = applyTarget(targets[next], startFrame, timer);
+			if (!animCurve.isNull())
+				createdCurves.push_back(make_pair(next, animCurve));
+		}
+
+		createPlayer(group < namespaces.size() ? MString(namespaces[group].name.c_str()) : MString(), startFrame);
+	}
+
+	timer.start("modifier");
 	m_dgmod.doIt();
-	m_animChange.redoIt();
+
+	// A new plan is cached once the modifier has created, renamed and connected its nodes, as those edits drop the cached
+	// plans. The plan refers to the curves it created, so the next load pastes into them. Plans of clips too large
+	// for the clip cache would never be reused.
+	if (newPlan && m_useCache && getClipCache().find(m_filePath.asChar(), newPlan->filterKey) == newPlan->clip)
+	{
+		for (const auto &created : createdCurves)
+			newPlan->targets[created.first].animCurve = created.second;
+
+		getApplyPlanCache().add(planKey, newPlan);
+	}
+
+	timer.start("undoRecording");
+	m_journal.recordAfter();
+	timer.stop();
+
+	m_isUndoable = m_journal.isValid();
+	if (!m_isUndoable && m_journal.limit() > 0)
+		MGlobal::displayWarning("Keys to undo exceed -undoLimit(-ul), the load cannot be undone");
+	m_profiler.addCount("undoBytes", m_journal.memorySize());
 
 	MGlobal::displayInfo("Import anim clip from '" + m_filePath + "'");
 
+	if (m_reduction.isEnabled())
+	{
+		MGlobal::displayInfo(m_reductionStats.toString().c_str());
+		m_profiler.addCount("reducedKeys", m_reductionStats.keysBefore - m_reductionStats.keysAfter);
+	}
+
+	setProfileResult(m_profiler, "loadAnimClip", m_filePath, m_profileFile);
 	return MS::kSuccess;
 }
 
 MStatus LoadAnimClipCommand::undoIt()
 {
-	m_animChange.undoIt();
+	m_journal.undo();
 	m_dgmod.undoIt();
 
+	return MS::kSuccess;
+}
+
+MStatus LoadAnimClipCommand::redoIt()
+{
+	m_dgmod.doIt();
+	m_journal.redo();
+
 	return MS::kSuccess;
 }
\ No newline at end of file
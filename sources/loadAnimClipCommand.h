@@ -2,8 +2,16 @@
 #include <maya/MArgList.h>
 #include <maya/MSyntax.h>
 #include <maya/MDGModifier.h>
-#include <maya/MAnimCurveChange.h>
 #include <maya/MSelectionList.h>
+#include <maya/MPlug.h>
+
+#include "clip.h"
+#include "profiler.h"
+#include "keyReduction.h"
+#include "applyPlan.h"
+#include "animCurveJournal.h"
+
+class AnimCurveIndex;
 
 class LoadAnimClipCommand : public MPxCommand
 {
@@ -12,18 +20,65 @@ public:
 
 	static MSyntax newSyntax();
 
-	virtual bool isUndoable() const { return true; }
+	virtual bool isUndoable() const { return m_isUndoable; }
 
 	virtual MStatus doIt(const MArgList& args);
 	virtual MStatus undoIt();
 	virtual MStatus redoIt();
 
 private:
+	// namespace the clip is applied to, keys are shifted by the offset from the start frame
+	struct NamespaceTarget
+	{
+		string name;
+		double timeOffset;
+	};
+
+	// plug driven by a player output instead of an animCurve
+	struct PlayerTarget
+	{
+		MString channel; // clip node and attribute
+		MPlug plug;
+		MObject output;
+		double rest;
+	};
+
+	MStatus apply();
+	bool readNamespaceFile(const MString &filePath);
+	void createPlayer(const MString &ns, double startFrame);
+
+	string getPlanKey(const vector<NamespaceTarget> &namespaces) const;
+	shared_ptr<ApplyPlan> makePlan(const vector<NamespaceTarget> &namespaces, Profiler::Timer &timer);
+	void resolveNode(const Clip &clip, const MObject &nodeObj, size_t group, AnimCurveIndex &curveIndex, ApplyPlan &plan);
+	// returns the curve created for the target, null when none is
+	MObject applyTarget(const ApplyPlan::Target &target, double startFrame, Profiler::Timer &timer);
+
 	MDGModifier m_dgmod;
-	MAnimCurveChange m_animChange;
+	AnimCurveJournal m_journal;
 	MSelectionList m_objectList;
-	MString m_namespace;
-	
+	vector<NamespaceTarget> m_namespaces;
+	vector<MString> m_attrNames; // per name id of the loaded clip
+	vector<PlayerTarget> m_playerTargets; // of the namespace being applied
+
+	// reused by the targets
+	CurveKeys m_channelKeys;
+	CurveData m_channelCurve;
+	CurveKeys m_reducedKeys;
+	CurveData m_reducedCurve;
+	CurveKeys m_existingKeys;
+	CurveKeys m_pastedKeys;
+
 	MString m_filePath;
 	double m_startFrame;
+	bool m_useCache;
+	bool m_foldConstant;
+	bool m_usePlayer;
+	int m_pasteMode;
+	bool m_isUndoable;
+
+	CurveTolerances m_reduction;
+	ReductionStats m_reductionStats;
+
+	Profiler m_profiler;
+	MString m_profileFile;
 };
\ No newline at end of file
@@ -0,0 +1,200 @@
+#include <cstring>
+#include <cstdint>
+#include <vector>
+
+#include "lz4Block.h"
+
+using namespace std;
+
+const size_t MinMatch = 4;
+const size_t LastLiterals = 5; // the last bytes of a block are always literals
+const size_t MatchFindLimit = 12; // no match starts in the last bytes of a block
+const size_t MaxOffset = 65535;
+const int HashBits = 16;
+const size_t WildCopy = 16; // bytes copied at once by the decoder
+
+static uint32_t read32(const char *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static uint64_t read64(const char *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static uint32_t hash32(uint32_t v)
+{
+	return (v * 2654435761u) >> (32 - HashBits);
+}
+
+// 15 in the token nibble, the rest as bytes of 255 and a last smaller byte
+static bool writeLength(char *&op, const char *opEnd, size_t length)
+{
+	for (; length >= 255; length -= 255)
+	{
+		if (op == opEnd)
+			return false;
+		*op++ = (char)255;
+	}
+
+	if (op == opEnd)
+		return false;
+	*op++ = (char)length;
+	return true;
+}
+
+static bool writeSequence(char *&op, const char *opEnd, const char *literals, size_t numLiterals, size_t offset, size_t matchLength)
+{
+	if (op == opEnd)
+		return false;
+
+	const size_t matchCode = matchLength ? matchLength - MinMatch : 0;
+	char *token = op++;
+	*token = (char)((numLiterals < 15 ? numLiterals : 15) << 4 | (matchCode < 15 ? matchCode : 15));
+
+	if (numLiterals >= 15 && !writeLength(op, opEnd, numLiterals - 15))
+		return false;
+
+	if ((size_t)(opEnd - op) < numLiterals)
+		return false;
+	memcpy(op, literals, numLiterals);
+	op += numLiterals;
+
+	if (!matchLength) // last literals
+		return true;
+
+	if (opEnd - op < 2)
+		return false;
+	*op++ = (char)(offset & 0xff);
+	*op++ = (char)(offset >> 8);
+
+	return matchCode < 15 || writeLength(op, opEnd, matchCode - 15);
+}
+
+size_t lz4Compress(const char *src, size_t srcSize, char *dst, size_t dstCapacity)
+{
+	char *op = dst;
+	const char *opEnd = dst + dstCapacity;
+
+	size_t anchor = 0;
+
+	if (srcSize > MatchFindLimit)
+	{
+		vector<uint32_t> table(size_t(1) << HashBits, UINT32_MAX); // last position of every hashed sequence
+		const size_t matchLimit = srcSize - LastLiterals;
+		const size_t findLimit = srcSize - MatchFindLimit;
+
+		size_t ip = 0;
+		while (ip < findLimit)
+		{
+			const uint32_t sequence = read32(src + ip);
+			const uint32_t h = hash32(sequence);
+			const size_t ref = table[h];
+			table[h] = (uint32_t)ip;
+
+			if (ref == UINT32_MAX || ip - ref > MaxOffset || read32(src + ref) != sequence)
+			{
+				ip += 1 + ((ip - anchor) >> 6); // skip faster through data which does not compress
+				continue;
+			}
+
+			// compared a word at a time, then byte by byte from the first differing word
+			size_t matchLength = MinMatch;
+			while (ip + matchLength + sizeof(uint64_t) <= matchLimit && read64(src + ref + matchLength) == read64(src + ip + matchLength))
+				matchLength += sizeof(uint64_t);
+			while (ip + matchLength < matchLimit && src[ref + matchLength] == src[ip + matchLength])
+				matchLength++;
+
+			if (!writeSequence(op, opEnd, src + anchor, ip - anchor, ip - ref, matchLength))
+				return 0;
+
+			ip += matchLength;
+			anchor = ip;
+		}
+	}
+
+	if (!writeSequence(op, opEnd, src + anchor, srcSize - anchor, 0, 0))
+		return 0;
+
+	return op - dst;
+}
+
+static bool readLength(const uint8_t *&ip, const uint8_t *ipEnd, size_t &length)
+{
+	uint8_t byte;
+	do
+	{
+		if (ip == ipEnd)
+			return false;
+		byte = *ip++;
+		length += byte;
+	} while (byte == 255);
+
+	return true;
+}
+
+bool lz4Decompress(const char *src, size_t srcSize, char *dst, size_t dstSize)
+{
+	const uint8_t *ip = (const uint8_t*)src;
+	const uint8_t *ipEnd = ip + srcSize;
+	char *op = dst;
+	char *opEnd = dst + dstSize;
+
+	while (ip < ipEnd)
+	{
+		const uint8_t token = *ip++;
+
+		size_t numLiterals = token >> 4;
+		if (numLiterals == 15 && !readLength(ip, ipEnd, numLiterals))
+			return false;
+
+		if ((size_t)(ipEnd - ip) < numLiterals || (size_t)(opEnd - op) < numLiterals)
+			return false;
+
+		// short literal runs are copied with a fixed size while both buffers have room for it
+		if (numLiterals <= WildCopy && ipEnd - ip >= (ptrdiff_t)WildCopy && opEnd - op >= (ptrdiff_t)WildCopy)
+			memcpy(op, ip, WildCopy);
+		else
+			memcpy(op, ip, numLiterals);
+		ip += numLiterals;
+		op += numLiterals;
+
+		if (ip == ipEnd) // last literals
+			break;
+
+		if (ipEnd - ip < 2)
+			return false;
+
+		const size_t offset = ip[0] | (size_t)ip[1] << 8;
+		ip += 2;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(ip, ipEnd, matchLength))
+			return false;
+		matchLength += MinMatch;
+
+		if (offset == 0 || offset > (size_t)(op - dst) || (size_t)(opEnd - op) < matchLength)
+			return false;
+
+		// a match may overlap its own output, words at least a word behind are already written
+		const char *match = op - offset;
+		if (offset >= sizeof(uint64_t) && (size_t)(opEnd - op) >= matchLength + sizeof(uint64_t))
+		{
+			for (size_t i = 0; i < matchLength; i += sizeof(uint64_t))
+				memcpy(op + i, match + i, sizeof(uint64_t));
+		}
+		else
+		{
+			for (size_t i = 0; i < matchLength; i++)
+				op[i] = match[i];
+		}
+		op += matchLength;
+	}
+
+	return op == opEnd;
+}
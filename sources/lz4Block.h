@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+// LZ4 block format codec, compatible with LZ4_compress_default and LZ4_decompress_safe.
+
+// Returns the compressed size, or zero when the data does not fit into dstCapacity bytes.
+size_t lz4Compress(const char *src, size_t srcSize, char *dst, size_t dstCapacity);
+
+// Fails on malformed input, or when the decompressed size is not exactly dstSize.
+bool lz4Decompress(const char *src, size_t srcSize, char *dst, size_t dstSize);
@@ -2,12 +2,18 @@
 
 #include "saveAnimClipCommand.h"
 #include "loadAnimClipCommand.h"
+#include "animClipCacheCommand.h"
+#include "animClipPlayerNode.h"
+#include "applyPlan.h"
 
 MStatus initializePlugin(MObject plugin)
 {
 	MFnPlugin pluginFn(plugin);
 	pluginFn.registerCommand("saveAnimClip", SaveAnimClipCommand::creator, SaveAnimClipCommand::newSyntax);
 	pluginFn.registerCommand("loadAnimClip", LoadAnimClipCommand::creator, LoadAnimClipCommand::newSyntax);
+	pluginFn.registerCommand("animClipCache", AnimClipCacheCommand::creator, AnimClipCacheCommand::newSyntax);
+	pluginFn.registerNode("animClipPlayer", AnimClipPlayerNode::id, AnimClipPlayerNode::creator, AnimClipPlayerNode::initialize);
+	getApplyPlanCache().addCallbacks();
 	return MS::kSuccess;
 }
 
@@ -16,5 +22,9 @@ MStatus uninitializePlugin(MObject plugin)
 	MFnPlugin pluginFn(plugin);
 	pluginFn.deregisterCommand("saveAnimClip");
 	pluginFn.deregisterCommand("loadAnimClip");
+	pluginFn.deregisterCommand("animClipCache");
+	pluginFn.deregisterNode(AnimClipPlayerNode::id);
+	getApplyPlanCache().removeCallbacks();
+	getClipCache().clear();
 	return MS::kSuccess;
 }
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "mappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_copyOnWrite(false)
+#ifdef _WIN32
+	, m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char *filePath, bool copyOnWrite)
+{
+	close();
+
+	// shared for delete, so a clip saved over a mapped file can replace it
+	m_file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, NULL, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	if (!m_mapping)
+	{
+		close();
+		return false;
+	}
+
+	m_data = (char*)MapViewOfFile(m_mapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	if (!m_data)
+	{
+		close();
+		return false;
+	}
+
+	m_size = (size_t)size.QuadPart;
+	m_copyOnWrite = copyOnWrite;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data && !m_buffer)
+		UnmapViewOfFile(m_data);
+
+	if (m_mapping)
+		CloseHandle(m_mapping);
+
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_copyOnWrite = false;
+	m_buffer.reset();
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const char *filePath, bool copyOnWrite)
+{
+	close();
+
+	const int fd = ::open(filePath, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void *data = mmap(nullptr, (size_t)st.st_size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (data == MAP_FAILED)
+		return false;
+
+	m_data = (char*)data;
+	m_size = (size_t)st.st_size;
+	m_copyOnWrite = copyOnWrite;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data && !m_buffer)
+		munmap(m_data, m_size);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_copyOnWrite = false;
+	m_buffer.reset();
+}
+
+#endif
+
+void MappedFile::assign(std::unique_ptr<char[]> data, size_t size)
+{
+	close();
+
+	m_buffer = std::move(data);
+	m_data = m_buffer.get();
+	m_size = size;
+	m_copyOnWrite = true;
+}
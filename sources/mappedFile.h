@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+// View of a whole file mapped into memory. A copy on write mapping can be modified in place, changes never reach the file.
+// The view can also be replaced by owned memory, such as the decompressed content of the file.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const char *filePath, bool copyOnWrite = false);
+	void close();
+
+	// unmaps the file and views the data instead, the data is writable
+	void assign(std::unique_ptr<char[]> data, size_t size);
+
+	bool isOpen() const { return m_data != nullptr; }
+	const char* data() const { return m_data; }
+	char* writableData() { return m_copyOnWrite ? m_data : nullptr; }
+	size_t size() const { return m_size; }
+
+private:
+	char *m_data;
+	size_t m_size;
+	bool m_copyOnWrite;
+	std::unique_ptr<char[]> m_buffer;
+
+#ifdef _WIN32
+	void *m_file;
+	void *m_mapping;
+#endif
+};
@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "outputFile.h"
+#include "lz4Block.h"
+
+using namespace std;
+
+string getTempSuffix(const void *writer, uint32_t counter)
+{
+#ifdef _WIN32
+	const char *host = getenv("COMPUTERNAME");
+	const string hostName = host ? host : "";
+	const int pid = _getpid();
+#else
+	char host[256] = {};
+	gethostname(host, sizeof(host) - 1);
+	const string hostName = host;
+	const int pid = (int)getpid();
+#endif
+	return "." + hostName + "." + to_string(pid) + "." + to_string((uintptr_t)writer) + "." + to_string(counter) + ".tmp";
+}
+
+// replaces an existing file, readers which have it open or mapped keep the old data
+static bool replaceFile(const char *sourcePath, const char *filePath)
+{
+#ifdef _WIN32
+	return MoveFileExA(sourcePath, filePath, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(sourcePath, filePath) == 0;
+#endif
+}
+
+OutputFile::OutputFile() : m_file(nullptr), m_numTempFiles(0), m_current(m_buffer), m_end(m_buffer + sizeof(m_buffer)), m_flushed(0), m_written(0), m_ioSeconds(0), m_failed(false),
+	m_compressed(false), m_compressionSeconds(0), m_decompressedIndex(SIZE_MAX)
+{
+}
+
+OutputFile::~OutputFile()
+{
+	discard();
+}
+
+bool OutputFile::open(const char *filePath)
+{
+	discard();
+
+	m_filePath = filePath;
+	m_tempPath = m_filePath + getTempSuffix(this, m_numTempFiles++);
+
+	const auto startTime = chrono::steady_clock::now();
+	m_file = fopen(m_tempPath.c_str(), "w+b"); // readable for read()
+	m_ioSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+	m_current = m_buffer;
+	m_flushed = 0;
+	m_written = 0;
+	m_failed = false;
+	m_compressionSeconds = 0;
+	m_pending.clear();
+	m_blocks.clear();
+	m_decompressedIndex = SIZE_MAX;
+
+	if (m_file && m_compressed)
+	{
+		BlockFileHeader header = {};
+		memcpy(header.magic, BlockFileMagic, sizeof(header.magic));
+		header.version = BlockFileVersion;
+		header.blockSize = (uint32_t)BlockFileBlockSize;
+		writeFile(&header, sizeof(header));
+	}
+
+	return m_file != nullptr;
+}
+
+void OutputFile::write(const void *data, size_t size)
+{
+	const char *bytes = (const char*)data;
+
+	while (size > 0)
+	{
+		if (m_current == m_end)
+			Flush();
+
+		const size_t n = min(size, size_t(m_end - m_current));
+		memcpy(m_current, bytes, n);
+		m_current += n;
+		bytes += n;
+		size -= n;
+	}
+}
+
+void OutputFile::writeFile(const void *data, size_t size)
+{
+	const auto startTime = chrono::steady_clock::now();
+	m_failed = m_failed || fwrite(data, 1, size, m_file) != size;
+	m_ioSeconds += chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+	m_written += size;
+}
+
+// the file position is moved back to the end, the next write appends
+bool OutputFile::readFile(uint64_t offset, void *data, size_t size)
+{
+	const auto startTime = chrono::steady_clock::now();
+#ifdef _WIN32
+	bool ok = fflush(m_file) == 0 && _fseeki64(m_file, (__int64)offset, SEEK_SET) == 0;
+#else
+	bool ok = fflush(m_file) == 0 && fseeko(m_file, (off_t)offset, SEEK_SET) == 0;
+#endif
+	ok = ok && fread(data, 1, size, m_file) == size;
+	ok = fseek(m_file, 0, SEEK_END) == 0 && ok;
+	m_ioSeconds += chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+	return ok;
+}
+
+bool OutputFile::read(uint64_t offset, void *data, size_t size)
+{
+	if (!m_file || m_failed || offset > tell() || size > tell() - offset)
+		return false;
+
+	char *bytes = (char*)data;
+	while (size > 0)
+	{
+		size_t n = 0;
+		if (offset >= m_flushed)
+		{
+			// still in the buffer
+			n = size;
+			memcpy(bytes, m_buffer + (offset - m_flushed), n);
+		}
+		else if (!m_compressed)
+		{
+			n = (size_t)min<uint64_t>(size, m_flushed - offset);
+			if (!readFile(offset, bytes, n))
+				return false;
+		}
+		else if (offset >= m_flushed - m_pending.size())
+		{
+			// waiting to be compressed
+			const size_t pendingOffset = (size_t)(offset - (m_flushed - m_pending.size()));
+			n = min(size, m_pending.size() - pendingOffset);
+			memcpy(bytes, m_pending.data() + pendingOffset, n);
+		}
+		else
+		{
+			// blocks before the pending data are whole, so the block follows from the offset
+			const size_t index = (size_t)(offset / BlockFileBlockSize);
+			const BlockFileBlock &block = m_blocks[index];
+			const size_t blockOffset = (size_t)(offset % BlockFileBlockSize);
+			n = min(size, block.size - blockOffset);
+
+			if (index != m_decompressedIndex)
+			{
+				m_decompressedIndex = SIZE_MAX;
+				m_decompressedBlock.resize(block.size);
+
+				if (block.compressedSize == block.size)
+				{
+					if (!readFile(block.offset, &m_decompressedBlock[0], block.size))
+						return false;
+				}
+				else
+				{
+					m_readBlock.resize(block.compressedSize);
+					if (!readFile(block.offset, &m_readBlock[0], block.compressedSize) ||
+						!lz4Decompress(m_readBlock.data(), m_readBlock.size(), &m_decompressedBlock[0], block.size))
+						return false;
+				}
+
+				m_decompressedIndex = index;
+			}
+
+			memcpy(bytes, m_decompressedBlock.data() + blockOffset, n);
+		}
+
+		offset += n;
+		bytes += n;
+		size -= n;
+	}
+	return true;
+}
+
+void OutputFile::Flush()
+{
+	const size_t size = m_current - m_buffer;
+	if (size == 0 || !m_file)
+		return;
+
+	if (m_compressed)
+	{
+		m_pending.append(m_buffer, size);
+
+		// a block per thread is compressed at once
+		if (m_pending.size() >= BlockFileBlockSize * max(1u, thread::hardware_concurrency()))
+			compressPending(false);
+	}
+	else
+		writeFile(m_buffer, size);
+
+	m_flushed += size;
+	m_current = m_buffer;
+}
+
+// whole blocks are compressed, the remainder waits for more data unless the file is closing
+void OutputFile::compressPending(bool isClosing)
+{
+	const size_t size = isClosing ? m_pending.size() : m_pending.size() / BlockFileBlockSize * BlockFileBlockSize;
+	if (size == 0)
+		return;
+
+	const auto startTime = chrono::steady_clock::now();
+	compressBlocks(m_pending.data(), size, m_compressedBlocks);
+	m_compressionSeconds += chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+	for (size_t i = 0; i < m_compressedBlocks.size(); i++)
+	{
+		const string &compressed = m_compressedBlocks[i];
+		const size_t offset = i * BlockFileBlockSize;
+
+		BlockFileBlock block = {};
+		block.offset = m_written;
+		block.size = (uint32_t)min(BlockFileBlockSize, size - offset);
+		block.compressedSize = compressed.empty() ? block.size : (uint32_t)compressed.size();
+		m_blocks.push_back(block);
+
+		if (compressed.empty())
+			writeFile(m_pending.data() + offset, block.size);
+		else
+			writeFile(compressed.data(), compressed.size());
+	}
+
+	m_pending.erase(0, size);
+}
+
+bool OutputFile::close()
+{
+	if (!m_file)
+		return false;
+
+	Flush();
+
+	if (m_compressed)
+	{
+		compressPending(true);
+
+		BlockFileFooter footer = {};
+		footer.blockTableOffset = m_written;
+		footer.size = m_flushed;
+		footer.blockCount = (uint32_t)m_blocks.size();
+		memcpy(footer.magic, BlockFileMagic, sizeof(footer.magic));
+
+		writeFile(m_blocks.data(), m_blocks.size() * sizeof(BlockFileBlock));
+		writeFile(&footer, sizeof(footer));
+	}
+
+	const auto startTime = chrono::steady_clock::now();
+	bool ok = fclose(m_file) == 0 && !m_failed;
+	ok = ok && replaceFile(m_tempPath.c_str(), m_filePath.c_str());
+	if (!ok)
+		remove(m_tempPath.c_str());
+	m_ioSeconds += chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+	m_file = nullptr;
+	return ok;
+}
+
+void OutputFile::discard()
+{
+	if (!m_file)
+		return;
+
+	fclose(m_file);
+	remove(m_tempPath.c_str());
+	m_file = nullptr;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "blockFile.h"
+
+// unique among writers of all processes and hosts, appended to a path to name its temporary file
+string getTempSuffix(const void *writer, uint32_t counter);
+
+// Buffered file output which measures time spent in writing. Also used as a rapidjson output stream.
+// A compressed output is written as a block file, offsets and tell() are still positions in the uncompressed data.
+// The data goes to a temporary file renamed over the target on close, so clips mapped from the target stay valid and
+// an output which is not closed never replaces the target.
+class OutputFile
+{
+public:
+	typedef char Ch;
+
+	OutputFile();
+	~OutputFile();
+
+	OutputFile(const OutputFile&) = delete;
+	OutputFile& operator=(const OutputFile&) = delete;
+
+	// data is written to a temporary file, close() renames it over the target, discard() or destruction removes it
+	bool open(const char *filePath);
+	bool close();
+	void discard();
+
+	// takes effect at the next open
+	void setCompressed(bool compressed) { m_compressed = compressed; }
+	bool isCompressed() const { return m_compressed; }
+
+	bool isOpen() const { return m_file != nullptr; }
+
+	void Put(char c)
+	{
+		if (m_current == m_end)
+			Flush();
+		*m_current++ = c;
+	}
+
+	void write(const void *data, size_t size);
+	void Flush();
+
+	// reads back data written since open, the offset is a position in the uncompressed data like tell()
+	bool read(uint64_t offset, void *data, size_t size);
+
+	uint64_t tell() const { return m_flushed + (m_current - m_buffer); }
+	uint64_t fileSize() const { return m_written; }
+	double ioSeconds() const { return m_ioSeconds; }
+	double compressionSeconds() const { return m_compressionSeconds; }
+
+private:
+	void writeFile(const void *data, size_t size);
+	bool readFile(uint64_t offset, void *data, size_t size);
+	void compressPending(bool isClosing);
+
+	FILE *m_file;
+	string m_filePath;
+	string m_tempPath;
+	uint32_t m_numTempFiles;
+	char m_buffer[65536];
+	char *m_current;
+	char *m_end;
+
+	uint64_t m_flushed;
+	uint64_t m_written;
+	double m_ioSeconds;
+	bool m_failed;
+
+	bool m_compressed;
+	double m_compressionSeconds;
+	string m_pending; // data waiting for a batch of blocks to compress
+	vector<string> m_compressedBlocks;
+	vector<BlockFileBlock> m_blocks;
+	string m_readBlock; // compressed block being read back
+	string m_decompressedBlock; // last block read back, dedup hits often read the same block again
+	size_t m_decompressedIndex;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// threads worth starting for the amount of work, small amounts run on the calling thread only
+inline size_t getNumThreads(size_t count, size_t work, size_t minWork)
+{
+	if (work < minWork)
+		return 1;
+
+	return min<size_t>(count, max(1u, thread::hardware_concurrency()));
+}
+
+// runs body for every index in [0, count), the calling thread takes part
+inline void parallelFor(size_t count, size_t numThreads, const function<void(size_t)> &body)
+{
+	atomic<size_t> next(0);
+
+	auto work = [&]()
+	{
+		for (size_t i = next++; i < count; i = next++)
+			body(i);
+	};
+
+	vector<thread> threads;
+	for (size_t i = 1; i < numThreads; i++)
+		threads.push_back(thread(work));
+
+	work();
+
+	for (auto &t : threads)
+		t.join();
+}
@@ -0,0 +1,116 @@
+#include <cstdio>
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/prettywriter.h"
+
+#include "profiler.h"
+
+using namespace rapidjson;
+
+void Profiler::clear()
+{
+	m_phases.clear();
+	m_counters.clear();
+}
+
+void Profiler::addTime(const char *phase, double seconds)
+{
+	if (!m_enabled)
+		return;
+
+	for (auto &p : m_phases)
+	{
+		if (p.first == phase)
+		{
+			p.second += seconds;
+			return;
+		}
+	}
+	m_phases.push_back(make_pair(string(phase), seconds));
+}
+
+void Profiler::addCount(const char *counter, uint64_t count)
+{
+	if (!m_enabled)
+		return;
+
+	for (auto &c : m_counters)
+	{
+		if (c.first == counter)
+		{
+			c.second += count;
+			return;
+		}
+	}
+	m_counters.push_back(make_pair(string(counter), count));
+}
+
+double Profiler::time(const char *phase) const
+{
+	for (const auto &p : m_phases)
+	{
+		if (p.first == phase)
+			return p.second;
+	}
+	return 0;
+}
+
+uint64_t Profiler::count(const char *counter) const
+{
+	for (const auto &c : m_counters)
+	{
+		if (c.first == counter)
+			return c.second;
+	}
+	return 0;
+}
+
+string Profiler::toJson(const string &command, const string &filePath) const
+{
+	StringBuffer buffer;
+	PrettyWriter<StringBuffer> writer(buffer);
+
+	double total = 0;
+	for (const auto &p : m_phases)
+		total += p.second;
+
+	writer.StartObject();
+	writer.Key("command");
+	writer.String(command.c_str());
+	writer.Key("file");
+	writer.String(filePath.c_str());
+	writer.Key("totalSeconds");
+	writer.Double(total);
+
+	writer.Key("phases");
+	writer.StartObject();
+	for (const auto &p : m_phases)
+	{
+		writer.Key(p.first.c_str());
+		writer.Double(p.second);
+	}
+	writer.EndObject();
+
+	writer.Key("counters");
+	writer.StartObject();
+	for (const auto &c : m_counters)
+	{
+		writer.Key(c.first.c_str());
+		writer.Uint64(c.second);
+	}
+	writer.EndObject();
+
+	writer.EndObject();
+	return buffer.GetString();
+}
+
+bool Profiler::writeJson(const string &command, const string &filePath, const string &reportPath) const
+{
+	FILE *f = fopen(reportPath.c_str(), "wb");
+	if (!f)
+		return false;
+
+	const string json = toJson(command, filePath);
+	const bool ok = fwrite(json.data(), 1, json.size(), f) == json.size();
+	return fclose(f) == 0 && ok;
+}
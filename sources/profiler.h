@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+// Accumulates wall time per phase and counters, reported as json. Does nothing when disabled.
+class Profiler
+{
+public:
+	Profiler() : m_enabled(false) {}
+
+	void setEnabled(bool enabled) { m_enabled = enabled; }
+	bool isEnabled() const { return m_enabled; }
+
+	void clear();
+
+	void addTime(const char *phase, double seconds);
+	void addCount(const char *counter, uint64_t count);
+
+	double time(const char *phase) const;
+	uint64_t count(const char *counter) const;
+
+	string toJson(const string &command, const string &filePath) const;
+	bool writeJson(const string &command, const string &filePath, const string &reportPath) const;
+
+	// adds time from construction till destruction to the phase
+	class Scope
+	{
+	public:
+		Scope(Profiler &profiler, const char *phase) : m_profiler(profiler), m_phase(phase)
+		{
+			if (m_profiler.m_enabled)
+				m_startTime = chrono::steady_clock::now();
+		}
+
+		~Scope()
+		{
+			if (m_profiler.m_enabled)
+				m_profiler.addTime(m_phase, chrono::duration<double>(chrono::steady_clock::now() - m_startTime).count());
+		}
+
+	private:
+		Profiler &m_profiler;
+		const char *m_phase;
+		chrono::steady_clock::time_point m_startTime;
+	};
+
+	// measures consecutive phases, starting a phase ends the previous one
+	class Timer
+	{
+	public:
+		Timer(Profiler &profiler) : m_profiler(profiler), m_phase(nullptr) {}
+		~Timer() { stop(); }
+
+		void start(const char *phase)
+		{
+			if (!m_profiler.m_enabled)
+				return;
+
+			const auto now = chrono::steady_clock::now();
+			if (m_phase)
+				m_profiler.addTime(m_phase, chrono::duration<double>(now - m_startTime).count());
+
+			m_phase = phase;
+			m_startTime = now;
+		}
+
+		void stop()
+		{
+			if (m_phase)
+				m_profiler.addTime(m_phase, chrono::duration<double>(chrono::steady_clock::now() - m_startTime).count());
+			m_phase = nullptr;
+		}
+
+	private:
+		Profiler &m_profiler;
+		const char *m_phase;
+		chrono::steady_clock::time_point m_startTime;
+	};
+
+private:
+	bool m_enabled;
+
+	// in order of first use
+	vector<pair<string, double>> m_phases;
+	vector<pair<string, uint64_t>> m_counters;
+};
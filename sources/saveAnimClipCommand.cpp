@@ -7,6 +7,9 @@
 #include <maya/MAnimUtil.h>
 #include <maya/MFnAnimCurve.h>
 #include <maya/MFnDependencyNode.h>
+#include <maya/MFnUnitAttribute.h>
+#include <maya/MDGContext.h>
+#include <maya/MDGContextGuard.h>
 #include <maya/MArgDatabase.h>
 #include <maya/MArgList.h>
 #include <maya/MArgParser.h>
@@ -14,18 +17,20 @@
 #include <vector>
 #include <set>
 #include <string>
-#include <fstream>
-
-#include "rapidjson/document.h"
-#include "rapidjson/ostreamwrapper.h"
-#include "rapidjson/writer.h"
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <cmath>
 
 #include "utils.h"
+#include "clip.h"
+#include "keyReduction.h"
 
 #include "saveAnimClipCommand.h"
+#include "animClipCacheCommand.h"
+#include "applyPlan.h"
 
 using namespace std;
-using namespace rapidjson;
 
 MSyntax SaveAnimClipCommand::newSyntax()
 {
@@ -34,108 +39,148 @@ MSyntax SaveAnimClipCommand::newSyntax()
 	syntax.addFlag("-f", "-file", MSyntax::MArgType::kString);
 	syntax.addFlag("-sf", "-startFrame", MSyntax::MArgType::kLong);
 	syntax.addFlag("-ef", "-endFrame", MSyntax::MArgType::kLong);
+	syntax.addFlag("-fmt", "-format", MSyntax::MArgType::kString);
+	syntax.addFlag("-p", "-profile");
+	syntax.addFlag("-pf", "-profileFile", MSyntax::MArgType::kString);
+	syntax.addFlag("-r", "-range", MSyntax::MArgType::kDouble, MSyntax::MArgType::kDouble, MSyntax::MArgType::kString);
+	syntax.makeFlagMultiUse("-r");
+	syntax.addFlag("-b", "-bake");
+	syntax.addFlag("-st", "-step", MSyntax::MArgType::kDouble);
+	addToleranceFlags(syntax, "-rd", "-reduce");
+	addToleranceFlags(syntax, "-qz", "-quantize");
+	syntax.addFlag("-fc", "-foldConstant");
+	syntax.addFlag("-cmp", "-compress");
+	syntax.addFlag("-cs", "-curveStore", MSyntax::MArgType::kString);
 
 	return syntax;
 };
 
-void getAnimCurveFrameData(const MFnAnimCurve& acFn, Value &outArray, Document::AllocatorType& allocator, double startFrame = DBL_MAX, double endFrame = DBL_MAX)
+void getAnimCurveData(const MObject &animCurveObject, CurveData &curve, CurveKeys &keys, double startFrame, double endFrame)
 {
-	// radians to degrees coeff
-	const double coeff = acFn.animCurveType() == MFnAnimCurve::kAnimCurveTA || acFn.animCurveType() == MFnAnimCurve::kAnimCurveUA ? 57.2958 : 1;
-
-	for (int i = 0; i < acFn.numKeys(); i++)
-	{
-		double t = acFn.isUnitlessInput() ? acFn.unitlessInput(i) : acFn.time(i).value();
-		if (endFrame != DBL_MAX && t > endFrame)
-			continue;
+	MFnAnimCurve acFn(animCurveObject);
 
-		if (startFrame != DBL_MAX)
-		{
-			if (t >= startFrame)
-				t -= startFrame;
-			else
-				continue;
-		}
+	curve.weighted = acFn.isWeighted();
+	curve.preInfinity = acFn.preInfinityType();
+	curve.postInfinity = acFn.postInfinityType();
+	curve.unit = (int)acFn.numKeys() > 0 ? acFn.time(0).unit() : 0;
 
-		const auto itt = acFn.inTangentType(i);
-		const auto ott = acFn.inTangentType(i);
+	getAnimCurveFrameData(acFn, keys, startFrame, endFrame);
+	curve.setKeys(keys);
+}
 
-		Value item(kArrayType);
-		item.PushBack(t, allocator);
-		item.PushBack(acFn.value(i) * coeff, allocator);
-		item.PushBack(Value(TangentTypes[itt].c_str(), allocator).Move(), allocator);
-		item.PushBack(Value(TangentTypes[ott].c_str(), allocator).Move(), allocator);
+// Points the curve to the keys in [startFrame, endFrame], found by binary search. Only times, which become relative
+// to the start frame, and fixed tangents, whose key indices shift, are copied to the slice.
+void sliceAnimCurveData(const CurveKeys &keys, double startFrame, double endFrame, CurveData &curve, CurveKeys &slice)
+{
+	const size_t first = lower_bound(keys.times.begin(), keys.times.end(), startFrame) - keys.times.begin();
+	const size_t last = upper_bound(keys.times.begin() + first, keys.times.end(), endFrame) - keys.times.begin();
 
-		if (itt == MFnAnimCurve::kTangentFixed || ott == MFnAnimCurve::kTangentFixed)
-		{
-			MAngle ia, oa;
-			double iw = 0, ow = 0;
+	slice.clear();
+	for (size_t i = first; i < last; i++)
+		slice.times.push_back(keys.times[i] - startFrame);
 
-			acFn.getTangent(i, ia, iw, true);
-			acFn.getTangent(i, oa, ow, false);
+	auto byKey = [](const FixedTangent &ft, uint32_t key) { return ft.key < key; };
+	auto fixed = lower_bound(keys.fixedTangents.begin(), keys.fixedTangents.end(), (uint32_t)first, byKey);
+	for (; fixed != keys.fixedTangents.end() && fixed->key < last; ++fixed)
+	{
+		slice.fixedTangents.push_back(*fixed);
+		slice.fixedTangents.back().key -= (uint32_t)first;
+	}
 
-			item.PushBack(acFn.weightsLocked(i), allocator);
-			item.PushBack(acFn.tangentsLocked(i), allocator);
-			item.PushBack(ia.value(), allocator);
-			item.PushBack(oa.value(), allocator);
-			item.PushBack(iw, allocator);
-			item.PushBack(ow, allocator);
+	curve.numKeys = last - first;
+	curve.times = slice.times.data();
+	curve.values = keys.values.data() + first;
+	curve.inTangentTypes = keys.inTangentTypes.data() + first;
+	curve.outTangentTypes = keys.outTangentTypes.data() + first;
+	curve.numFixedTangents = slice.fixedTangents.size();
+	curve.fixedTangents = slice.fixedTangents.data();
+}
 
-			if (acFn.isWeighted())
-			{
-				MFnAnimCurve::TangentValue ix, ox;
-				MFnAnimCurve::TangentValue iy, oy;
+// nodes grouped by local name, so each one is streamed as a single clip node
+struct NodeGroups
+{
+	StringTable names; // name ids are group indices
+	vector<MObjectArray> objects;
+	vector<vector<pair<MPlug, MObject>>> curves;
+	vector<vector<size_t>> channels; // indices of sampled plugs
 
-				acFn.getTangent(i, ix, iy, true);
-				acFn.getTangent(i, ox, oy, false);
+	size_t add(const MObject &nodeObj)
+	{
+		const string nodeName = getNodeLocalName(MFnDependencyNode(nodeObj));
 
-				item.PushBack(ix, allocator);
-				item.PushBack(iy, allocator);
-				item.PushBack(ox, allocator);
-				item.PushBack(oy, allocator);
-			}
+		const size_t n = names.intern(nodeName.c_str(), nodeName.size());
+		if (n == objects.size())
+		{
+			objects.push_back(MObjectArray());
+			curves.push_back({});
+			channels.push_back({});
 		}
 
-		outArray.PushBack(item, allocator);
-	}
-}
+		MObjectArray &nodeObjects = objects[n];
+		bool isAdded = false;
+		for (unsigned int k = 0; k < nodeObjects.length() && !isAdded; k++)
+			isAdded = nodeObjects[k] == nodeObj;
 
-void getAnimCurveData(const MObject &animCurveObject, Value &outObject, Document::AllocatorType& allocator, double startFrame = DBL_MAX, double endFrame = DBL_MAX)
-{
-	MFnAnimCurve acFn(animCurveObject);
-	MPlug outputPlug = acFn.findPlug("output", true);
+		if (!isAdded)
+			nodeObjects.append(nodeObj);
 
-	MPlugArray destinations;
-	MString nodeName, attrName;
-	if (outputPlug.destinationsWithConversions(destinations))
-	{
-		MFnDependencyNode nodeFn(destinations[0].node());
-		MStringArray nameParts;
-		nodeFn.name().split(':', nameParts);
-		nodeName = nameParts[nameParts.length() - 1].asChar();
-		attrName = destinations[0].partialName().asChar();
+		return n;
 	}
-
-	outObject.AddMember("weighted", acFn.isWeighted(), allocator);
-	outObject.AddMember("preinf", acFn.preInfinityType(), allocator);
-	outObject.AddMember("postinf", acFn.postInfinityType(), allocator);
-	outObject.AddMember("unit", (int)acFn.numKeys() > 0 ? acFn.time(0).unit() : 0, allocator);
-	outObject.AddMember("data", Value(kArrayType), allocator);
-
-	getAnimCurveFrameData(acFn, outObject["data"], allocator, startFrame, endFrame);
-}
+};
 
 MStatus SaveAnimClipCommand::doIt(const MArgList& args)
 {
 	MArgParser argParser(syntax(), args);
 
-	if (!argParser.isFlagSet("-f"))
+	if (!argParser.isFlagSet("-f") && !argParser.isFlagSet("-r"))
 	{
 		MGlobal::displayError("-file(-f) flag must be specified with a file path");
 		return MS::kFailure;
 	}
 
-	argParser.getFlagArgument("-f", 0, m_filePath);
+	if (argParser.isFlagSet("-f"))
+		argParser.getFlagArgument("-f", 0, m_filePath);
+
+	// ranges are exported in a single scene traversal
+	for (unsigned int i = 0; i < argParser.numberOfFlagUses("-r"); i++)
+	{
+		MArgList rangeArgs;
+		argParser.getFlagArgumentList("-r", i, rangeArgs);
+
+		ClipRange range;
+		range.startFrame = rangeArgs.asDouble(0);
+		range.endFrame = rangeArgs.asDouble(1);
+		range.filePath = rangeArgs.asString(2);
+		range.format = getClipFormat(range.filePath.asChar());
+
+		if (range.endFrame < range.startFrame)
+		{
+			MGlobal::displayError("-range(-r) end frame must not be less than its start frame");
+			return MS::kFailure;
+		}
+
+		m_ranges.push_back(range);
+	}
+
+	m_format = getClipFormat(m_filePath.asChar());
+	if (argParser.isFlagSet("-fmt"))
+	{
+		MString format;
+		argParser.getFlagArgument("-fmt", 0, format);
+
+		if (format == "json")
+			m_format = JsonClipFormat;
+		else if (format == "binary")
+			m_format = BinaryClipFormat;
+		else
+		{
+			MGlobal::displayError("-format(-fmt) flag must be either 'json' or 'binary'");
+			return MS::kFailure;
+		}
+
+		for (auto &range : m_ranges)
+			range.format = m_format;
+	}
 
 	if (argParser.isFlagSet("-sf"))
 		argParser.getFlagArgument("-sf", 0, m_startFrame);
@@ -147,111 +192,489 @@ MStatus SaveAnimClipCommand::doIt(const MArgList& args)
 	else
 		m_endFrame = DBL_MAX;
 
-	redoIt();
-	return MS::kSuccess;
+	m_bake = argParser.isFlagSet("-b");
+
+	m_step = 1;
+	if (argParser.isFlagSet("-st"))
+		argParser.getFlagArgument("-st", 0, m_step);
+
+	if (m_step <= 0)
+	{
+		MGlobal::displayError("-step(-st) must be positive");
+		return MS::kFailure;
+	}
+
+	m_reduction = getTolerances(argParser, "-rd");
+	m_quantization = getTolerances(argParser, "-qz");
+	m_foldConstant = argParser.isFlagSet("-fc");
+	m_compress = argParser.isFlagSet("-cmp");
+
+	m_curveStore.clear();
+	if (argParser.isFlagSet("-cs"))
+		argParser.getFlagArgument("-cs", 0, m_curveStore);
+
+	if (argParser.isFlagSet("-pf"))
+		argParser.getFlagArgument("-pf", 0, m_profileFile);
+
+	m_profiler.setEnabled(argParser.isFlagSet("-p") || argParser.isFlagSet("-pf"));
+
+	return redoIt();
+}
+
+// jobs are ordered by attribute then by range, the curves of all ranges of a node are reduced together, constant curves are folded into statics
+void SaveAnimClipCommand::writeCurves(const vector<MString> &attrNames, vector<ReductionJob> &jobs, const vector<ClipWriter*> &writers, Profiler::Timer &timer)
+{
+	if (m_reduction.isEnabled())
+	{
+		timer.start("reduction");
+		reduceCurves(jobs, m_reduction);
+	}
+
+	vector<FoldedStatic> statics;
+
+	timer.start("serialization");
+	for (size_t j = 0; j < jobs.size(); j++)
+	{
+		const ReductionJob &job = jobs[j];
+		ClipWriter *writer = writers[j % writers.size()];
+		const MString &attrName = attrNames[j / writers.size()];
+
+		// keys within the reduction tolerance of one value are folded
+		double value;
+		if (m_foldConstant && isConstantCurve(*job.curve, m_reduction.get(job.animCurveType), value))
+		{
+			statics.push_back({ writer, attrName, isAngularCurveType(job.animCurveType) ? value * DegreesToRadians : value });
+			continue;
+		}
+
+		CurveData curve = m_reduction.isEnabled() ? job.result : *job.curve;
+		curve.tolerance = m_quantization.get(job.animCurveType);
+		if (job.isReduced)
+			m_reductionStats.add(*job.curve, job.result, job.animCurveType, job.maxError);
+
+		writer->writeCurve(attrName.asChar(), curve);
+		m_profiler.addCount("keys", curve.numKeys);
+	}
+
+	writeStatics(statics);
+}
+
+void SaveAnimClipCommand::writeStatics(vector<FoldedStatic> &statics)
+{
+	for (const auto &folded : statics)
+		folded.writer->writeStatic(folded.attr.asChar(), folded.value);
+
+	m_profiler.addCount("foldedStatics", statics.size());
+	statics.clear();
+}
+
+// keyable plugs of the selection are sampled over all ranges, so constraints, expressions and other inputs are captured
+void SaveAnimClipCommand::bake(const MSelectionList &selList, const vector<ClipWriter*> &writers, const vector<const ClipRange*> &ranges, Profiler::Timer &timer)
+{
+	timer.start("traversal");
+
+	double startFrame = DBL_MAX;
+	double endFrame = -DBL_MAX;
+	for (const ClipRange *range : ranges)
+	{
+		startFrame = min(startFrame, range->startFrame);
+		endFrame = max(endFrame, range->endFrame);
+	}
+
+	NodeGroups nodes;
+	vector<MPlug> plugs;
+	vector<double> coeffs;
+	vector<int> animCurveTypes; // choose the tolerances, reduced channels are written as curves of this type
+
+	for (int i = 0; i < selList.length(); i++)
+	{
+		MObject nodeObj;
+		selList.getDependNode(i, nodeObj);
+		const size_t n = nodes.add(nodeObj);
+
+		MFnDependencyNode nodeFn(nodeObj);
+		for (int k = 0; k < nodeFn.attributeCount(); k++)
+		{
+			const MObject attr = nodeFn.attribute(k);
+			const MPlug plug(nodeObj, attr);
+			if (!plug.isKeyable() || plug.isCompound() || plug.isArray() || plug.partialName() == "ro") // rotate order is saved as static
+				continue;
+
+			const auto unitType = attr.hasFn(MFn::kUnitAttribute) ? MFnUnitAttribute(attr).unitType() : MFnUnitAttribute::kInvalid;
+			const bool isAngular = unitType == MFnUnitAttribute::kAngle;
+
+			nodes.channels[n].push_back(plugs.size());
+			plugs.push_back(plug);
+			coeffs.push_back(isAngular ? RadiansToDegrees : 1);
+			animCurveTypes.push_back(isAngular ? MFnAnimCurve::kAnimCurveTA : unitType == MFnUnitAttribute::kDistance ? MFnAnimCurve::kAnimCurveTL : MFnAnimCurve::kAnimCurveTU);
+		}
+	}
+
+	// the scene is evaluated once per sample, time outermost
+	const MTime::Unit unit = MTime::uiUnit();
+	const size_t numSamples = (size_t)floor((endFrame - startFrame) / m_step + 1e-9) + 1;
+
+	vector<vector<double>> samples(plugs.size(), vector<double>(numSamples));
+
+	timer.start("extraction");
+	for (size_t i = 0; i < numSamples; i++)
+	{
+		const MDGContext context(MTime(startFrame + i * m_step, unit));
+		MDGContextGuard guard(context);
+
+		for (size_t p = 0; p < plugs.size(); p++)
+			samples[p][i] = plugs[p].asDouble() * coeffs[p];
+	}
+
+	// channels are reduced node by node, reduced curves are written before the channels
+	ChannelReducer reducer;
+	vector<pair<ClipWriter*, MString>> channelAttrs; // per reducer channel
+	vector<FoldedStatic> statics;
+
+	for (size_t n = 0; n < nodes.names.size(); n++)
+	{
+		timer.start("serialization");
+		for (ClipWriter *writer : writers)
+			writer->beginNode(nodes.names.get(n));
+
+		reducer.clear();
+		channelAttrs.clear();
+
+		for (size_t p : nodes.channels[n])
+		{
+			const MString attrName = plugs[p].partialName();
+
+			for (size_t r = 0; r < writers.size(); r++)
+			{
+				// samples inside the range
+				const size_t first = (size_t)max(0.0, ceil((ranges[r]->startFrame - startFrame) / m_step - 1e-9));
+				const size_t last = min(numSamples, (size_t)floor((ranges[r]->endFrame - startFrame) / m_step + 1e-9) + 1);
+
+				ChannelData channel;
+				channel.unit = unit;
+				channel.start = startFrame + first * m_step - ranges[r]->startFrame;
+				channel.step = m_step;
+				channel.numValues = last > first ? last - first : 0;
+				channel.values = samples[p].data() + first;
+				channel.tolerance = m_quantization.get(animCurveTypes[p]);
+
+				m_profiler.addCount("samples", channel.numValues);
+
+				// values within the reduction tolerance of one value are folded
+				double value;
+				if (m_foldConstant && isConstantChannel(channel, m_reduction.get(animCurveTypes[p]), value))
+					statics.push_back({ writers[r], attrName, value / coeffs[p] });
+				else
+				{
+					reducer.add(channel, animCurveTypes[p]);
+					channelAttrs.push_back(make_pair(writers[r], attrName));
+				}
+			}
+
+			m_profiler.addCount("channels", 1);
+		}
+
+		if (m_reduction.isEnabled())
+		{
+			timer.start("reduction");
+			reducer.reduce(m_reduction);
+			timer.start("serialization");
+		}
+
+		for (size_t i = 0; i < reducer.size(); i++)
+		{
+			const ReductionJob *job = reducer.reduced(i);
+			if (!job)
+				continue;
+
+			CurveData curve = job->result;
+			curve.tolerance = reducer.channel(i).tolerance;
+			m_reductionStats.add(*job->curve, job->result, job->animCurveType, job->maxError);
+
+			channelAttrs[i].first->writeCurve(channelAttrs[i].second.asChar(), curve);
+			m_profiler.addCount("keys", curve.numKeys);
+		}
+
+		for (size_t i = 0; i < reducer.size(); i++)
+		{
+			if (!reducer.reduced(i))
+				channelAttrs[i].first->writeChannel(channelAttrs[i].second.asChar(), reducer.channel(i));
+		}
+
+		writeStatics(statics);
+
+		for (unsigned int j = 0; j < nodes.objects[n].length(); j++)
+		{
+			const MPlug p = MFnDependencyNode(nodes.objects[n][j]).findPlug("ro", true);
+			if (!p.isNull())
+			{
+				for (ClipWriter *writer : writers)
+					writer->writeStatic("ro", p.asShort());
+				break;
+			}
+		}
+
+		for (ClipWriter *writer : writers)
+			writer->endNode();
+	}
+
+	m_profiler.addCount("nodes", nodes.names.size());
 }
 
 MStatus SaveAnimClipCommand::redoIt()
 {
-	MDoubleArray result;
-	MGlobal::executeCommand("timeControl -q -ra $gPlayBackSlider;", result);
-	const double startFrame = m_startFrame == DBL_MAX ? result[0] : m_startFrame;
-	const double endFrame = m_endFrame == DBL_MAX ? result[1] : m_endFrame;
+	m_profiler.clear();
+	m_reductionStats = ReductionStats();
+
+	vector<ClipRange> ranges = m_ranges;
+	if (m_filePath.length() > 0 || ranges.empty())
+	{
+		MDoubleArray result;
+		MGlobal::executeCommand("timeControl -q -ra $gPlayBackSlider;", result);
+
+		ClipRange range;
+		range.startFrame = m_startFrame == DBL_MAX ? result[0] : m_startFrame;
+		range.endFrame = m_endFrame == DBL_MAX ? result[1] : m_endFrame;
+		range.filePath = m_filePath;
+		range.format = m_format;
+		ranges.insert(ranges.begin(), range);
+	}
+
+	// short ranges save the current pose
+	vector<unique_ptr<ClipWriter>> writers;
+	vector<ClipWriter*> poseWriters, animWriters;
+	vector<const ClipRange*> animRanges;
+	double openSeconds = 0;
+
+	for (const auto &range : ranges)
+	{
+		writers.push_back(createClipWriter(range.format));
+		ClipWriter &writer = *writers.back();
+		writer.setCompressed(m_compress);
+		if (m_curveStore.length())
+			writer.setCurveStore(m_curveStore.asChar());
+		if (!writer.open(range.filePath.asChar()))
+		{
+			// no file is replaced unless every range can be written
+			for (const auto &opened : writers)
+				opened->discard();
+
+			MGlobal::displayError("Cannot write file '" + range.filePath + "'");
+			return MS::kFailure;
+		}
+
+		openSeconds += writer.output().ioSeconds();
+
+		if (range.endFrame - range.startFrame <= 1.0)
+			poseWriters.push_back(&writer);
+		else
+		{
+			animWriters.push_back(&writer);
+			animRanges.push_back(&range);
+		}
+	}
+
+	Profiler::Timer timer(m_profiler);
+	timer.start("traversal");
 
 	MSelectionList selList;
 	MGlobal::getActiveSelectionList(selList);
 
-	Document doc(kObjectType);
-
-	if (endFrame - startFrame <= 1.0)
+	if (!poseWriters.empty())
 	{
 		// save current pose for selected nodes
+		NodeGroups nodes;
 		for (int i = 0; i < selList.length(); i++)
 		{
 			MObject nodeObj;
 			selList.getDependNode(i, nodeObj);
-			MFnDependencyNode nodeFn(nodeObj);
-
-			const string nodeName = getNodeLocalName(nodeFn);
-			const char *node = nodeName.c_str();
+			nodes.add(nodeObj);
+		}
 
+		for (size_t n = 0; n < nodes.names.size(); n++)
+		{
+			timer.start("serialization");
+			for (ClipWriter *writer : poseWriters)
+				writer->beginNode(nodes.names.get(n));
 
-			if (!doc.HasMember(node))
+			for (unsigned int j = 0; j < nodes.objects[n].length(); j++)
 			{
-				doc.AddMember(Value(node, doc.GetAllocator()).Move(), Value(kObjectType), doc.GetAllocator());
+				const MObject &nodeObj = nodes.objects[n][j];
+				MFnDependencyNode nodeFn(nodeObj);
 
-				doc[node].AddMember("animation", Value(kObjectType), doc.GetAllocator());
-				doc[node].AddMember("static", Value(kObjectType), doc.GetAllocator());
-				doc[node].AddMember("others", Value(kObjectType), doc.GetAllocator());
-			}
+				for (int k = 0; k < nodeFn.attributeCount(); k++)
+				{
+					timer.start("extraction");
+					const MPlug plug(nodeObj, nodeFn.attribute(k));
+					if (plug.isKeyable())
+					{
+						const MString attrName = plug.partialName();
+						const double value = plug.asDouble();
+
+						timer.start("serialization");
+						for (ClipWriter *writer : poseWriters)
+							writer->writeStatic(attrName.asChar(), value);
+						m_profiler.addCount("statics", 1);
+					}
+				}
 
-			for (int k = 0; k < nodeFn.attributeCount(); k++)
-			{
-				const MPlug plug(nodeObj, nodeFn.attribute(k));
-				if (plug.isKeyable())
-					doc[node]["static"].AddMember(Value(plug.partialName().asChar(), doc.GetAllocator()).Move(), Value(plug.asDouble()), doc.GetAllocator());
+				// save rotateOrder for each selected node
+				const MPlug p = nodeFn.findPlug("ro", true);
+				if (!p.isNull())
+				{
+					for (ClipWriter *writer : poseWriters)
+						writer->writeStatic("ro", p.asShort());
+				}
 			}
 
-			// save rotateOrder for each selected node
-			const MPlug p = nodeFn.findPlug("ro", true);
-			if (!p.isNull())
-				doc[node]["static"].AddMember(Value("ro", doc.GetAllocator()).Move(), Value(p.asShort()), doc.GetAllocator());
+			timer.start("serialization");
+			for (ClipWriter *writer : poseWriters)
+				writer->endNode();
 		}
 
-		MGlobal::displayInfo("Export pose clip to '" + m_filePath + "'");
+		m_profiler.addCount("nodes", nodes.names.size());
 	}
-	else
+
+	if (!animWriters.empty() && m_bake)
+		bake(selList, animWriters, animRanges, timer);
+	else if (!animWriters.empty())
 	{
+		timer.start("traversal");
+
+		// keys of all ranges are extracted once
+		double startFrame = DBL_MAX;
+		double endFrame = -DBL_MAX;
+		for (const ClipRange *range : animRanges)
+		{
+			startFrame = min(startFrame, range->startFrame);
+			endFrame = max(endFrame, range->endFrame);
+		}
+
 		// find animation curves on selected objects and export them
 		MPlugArray plugs;
 		MAnimUtil::findAnimatedPlugs(selList, plugs, false);
 
-		for (int i = 0; i < plugs.length(); i++)
+		NodeGroups nodes;
+		AnimCurveIndex curveIndex;
+		for (unsigned int i = 0; i < plugs.length(); i++)
 		{
-			MObjectArray animCurves;
-			findAnimationCurves(plugs[i], animCurves);
+			curveIndex.addNode(plugs[i].node());
+
+			const MObject animCurve = curveIndex.find(plugs[i]);
+			if (!animCurve.isNull())
+				nodes.curves[nodes.add(plugs[i].node())].push_back(make_pair(plugs[i], animCurve));
+		}
 
-			if (animCurves.length() > 0)
+		// keys and slices of the curves of a node, kept until the node is written
+		vector<MString> attrNames;
+		vector<ReductionJob> jobs;
+		deque<CurveKeys> curveKeys, slices;
+		deque<CurveData> sliceCurves;
+
+		for (size_t n = 0; n < nodes.names.size(); n++)
+		{
+			timer.start("serialization");
+			for (ClipWriter *writer : animWriters)
+				writer->beginNode(nodes.names.get(n));
+
+			attrNames.clear();
+			jobs.clear();
+			curveKeys.clear();
+			slices.clear();
+			sliceCurves.clear();
+
+			for (const auto &plugCurve : nodes.curves[n])
 			{
-				MFnDependencyNode nodeFn(plugs[i].node());
-				const string nodeName = getNodeLocalName(nodeFn);
-				const string attrName(plugs[i].partialName().asChar());
+				timer.start("extraction");
+				CurveData curve;
+				curveKeys.emplace_back();
+				getAnimCurveData(plugCurve.second, curve, curveKeys.back(), startFrame, endFrame);
+				attrNames.push_back(plugCurve.first.partialName());
 
-				const char* node = nodeName.c_str();
-				const char* attr = attrName.c_str();
+				const int animCurveType = (int)MFnAnimCurve(plugCurve.second).animCurveType();
 
-				if (!doc.HasMember(node))
+				for (size_t r = 0; r < animWriters.size(); r++)
 				{
-					doc.AddMember(Value(node, doc.GetAllocator()).Move(), Value(kObjectType), doc.GetAllocator());
+					slices.emplace_back();
+					sliceCurves.push_back(curve);
+					sliceAnimCurveData(curveKeys.back(), animRanges[r]->startFrame, animRanges[r]->endFrame, sliceCurves.back(), slices.back());
 
-					doc[node].AddMember("animation", Value(kObjectType), doc.GetAllocator());
-					doc[node].AddMember("static", Value(kObjectType), doc.GetAllocator());
-					doc[node].AddMember("others", Value(kObjectType), doc.GetAllocator());
+					jobs.emplace_back();
+					jobs.back().curve = &sliceCurves.back();
+					jobs.back().animCurveType = animCurveType;
 				}
 
-				// save rotateOrder for each selected node
-				if (!doc[node]["static"].HasMember("ro"))
-				{
-					const MPlug p = nodeFn.findPlug("ro", true);
-					if (!p.isNull())
-						doc[node]["static"].AddMember(Value("ro", doc.GetAllocator()).Move(), Value(p.asShort()), doc.GetAllocator());
-				}
+				m_profiler.addCount("curves", 1);
+			}
 
-				doc[node]["animation"].AddMember(Value(attr, doc.GetAllocator()).Move(), Value(kObjectType), doc.GetAllocator());
+			writeCurves(attrNames, jobs, animWriters, timer);
 
-				getAnimCurveData(animCurves[0], doc[node]["animation"][attr], doc.GetAllocator(), startFrame, endFrame);
+			// save rotateOrder for each selected node
+			const MPlug p = MFnDependencyNode(nodes.objects[n][0]).findPlug("ro", true);
+			if (!p.isNull())
+			{
+				for (ClipWriter *writer : animWriters)
+					writer->writeStatic("ro", p.asShort());
 			}
+
+			for (ClipWriter *writer : animWriters)
+				writer->endNode();
 		}
 
-		MGlobal::displayInfo("Export anim clip in range " + TO_MSTR(int(startFrame)) + ".." + TO_MSTR(int(endFrame)) + " to '" + m_filePath+"'");
+		m_profiler.addCount("nodes", nodes.names.size());
 	}
 
-	ofstream ofs(m_filePath.asChar());
-	OStreamWrapper osw(ofs);
+	// buffer flushes happened inside the timed phases, they are moved to io and compression
+	timer.stop();
+
+	double ioSeconds = 0;
+	for (const auto &writer : writers)
+		ioSeconds += writer->output().ioSeconds() + writer->output().compressionSeconds();
+	m_profiler.addTime("serialization", openSeconds - ioSeconds);
+
+	// Cached clips and plans of the files are dropped before they are replaced, so they do not keep the old files mapped,
+	// which would keep Windows from replacing them
+	for (const auto &range : ranges)
+		getClipCache().remove(range.filePath.asChar());
+	getApplyPlanCache().clear();
+
+	// every range is closed and reported, a range which fails does not keep the others from being written
+	ioSeconds = 0;
+	double compressionSeconds = 0;
+	bool isEveryWritten = true;
+	for (size_t i = 0; i < writers.size(); i++)
+	{
+		const bool isWritten = writers[i]->close();
+		ioSeconds += writers[i]->output().ioSeconds();
+		compressionSeconds += writers[i]->output().compressionSeconds();
+		m_profiler.addCount("bytes", writers[i]->output().fileSize());
+
+		if (!isWritten)
+		{
+			MGlobal::displayError("Cannot write file '" + ranges[i].filePath + "'");
+			isEveryWritten = false;
+			continue;
+		}
 
-	Writer<OStreamWrapper> writer(osw);
-	doc.Accept(writer);
+		if (ranges[i].endFrame - ranges[i].startFrame <= 1.0)
+			MGlobal::displayInfo("Export pose clip to '" + ranges[i].filePath + "'");
+		else
+			MGlobal::displayInfo("Export anim clip in range " + TO_MSTR(int(ranges[i].startFrame)) + ".." + TO_MSTR(int(ranges[i].endFrame)) + " to '" + ranges[i].filePath + "'");
+	}
+	m_profiler.addTime("io", ioSeconds);
+	if (m_compress)
+		m_profiler.addTime("compression", compressionSeconds);
+
+	if (!isEveryWritten)
+		return MS::kFailure;
+
+	if (m_reduction.isEnabled())
+	{
+		MGlobal::displayInfo(m_reductionStats.toString().c_str());
+		m_profiler.addCount("reducedKeys", m_reductionStats.keysBefore - m_reductionStats.keysAfter);
+	}
 
+	setProfileResult(m_profiler, "saveAnimClip", ranges[0].filePath, m_profileFile);
 	return MS::kSuccess;
 }
 
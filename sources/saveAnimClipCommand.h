@@ -1,6 +1,10 @@
 #include <maya/MPxCommand.h>
 #include <maya/MArgList.h>
 #include <maya/MSyntax.h>
+#include <maya/MSelectionList.h>
+
+#include "clip.h"
+#include "keyReduction.h"
 
 class SaveAnimClipCommand : public MPxCommand
 {
@@ -16,8 +20,45 @@ public:
 	virtual MStatus redoIt();
 
 private:
+	// frame range exported to its own file
+	struct ClipRange
+	{
+		double startFrame;
+		double endFrame;
+		MString filePath;
+		ClipFormat format;
+	};
+
+	// constant curve or channel, written to the static section after the curves of its node
+	struct FoldedStatic
+	{
+		ClipWriter *writer;
+		MString attr;
+		double value;
+	};
+
+	void writeStatics(vector<FoldedStatic> &statics);
+	void writeCurves(const vector<MString> &attrNames, vector<ReductionJob> &jobs, const vector<ClipWriter*> &writers, Profiler::Timer &timer);
+	void bake(const MSelectionList &selList, const vector<ClipWriter*> &writers, const vector<const ClipRange*> &ranges, Profiler::Timer &timer);
+
 	MString m_filePath;
+	ClipFormat m_format;
 
 	double m_startFrame;
 	double m_endFrame;
+
+	vector<ClipRange> m_ranges;
+
+	bool m_bake;
+	double m_step; // frames between baked samples
+
+	CurveTolerances m_reduction;
+	CurveTolerances m_quantization; // of values in binary clips
+	bool m_foldConstant;
+	bool m_compress;
+	MString m_curveStore; // directory of keys shared between binary clips
+	ReductionStats m_reductionStats;
+
+	Profiler m_profiler;
+	MString m_profileFile;
 };
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include <algorithm>
+
+#include "stringTable.h"
+
+const size_t ChunkSize = 16 * 1024;
+const size_t MinSlots = 64;
+
+// FNV-1a
+static uint64_t hashString(const char *str, size_t length)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= (uint8_t)str[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+StringTable::StringTable(const vector<string> &strings)
+{
+	for (const auto &str : strings)
+		intern(str.c_str(), str.size());
+}
+
+// long strings get a chunk of their own, so the current chunk keeps its free space
+const char* StringTable::copyString(const char *str, size_t length)
+{
+	char *copy;
+	if (length + 1 > ChunkSize / 4)
+	{
+		m_chunks.push_back(unique_ptr<char[]>(new char[length + 1]));
+		copy = m_chunks.back().get();
+	}
+	else
+	{
+		if (!m_chunk || m_chunkUsed + length + 1 > ChunkSize)
+		{
+			m_chunks.push_back(unique_ptr<char[]>(new char[ChunkSize]));
+			m_chunk = m_chunks.back().get();
+			m_chunkUsed = 0;
+		}
+
+		copy = m_chunk + m_chunkUsed;
+		m_chunkUsed += length + 1;
+	}
+
+	memcpy(copy, str, length);
+	copy[length] = '\0';
+	return copy;
+}
+
+size_t StringTable::findSlot(const char *str, size_t length, uint64_t hash) const
+{
+	const size_t mask = m_slots.size() - 1;
+	for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+	{
+		const uint32_t index = m_slots[slot];
+		if (index == 0)
+			return slot;
+
+		const Entry &entry = m_entries[index - 1];
+		if (entry.hash == hash && entry.length == length && memcmp(entry.str, str, length) == 0)
+			return slot;
+	}
+}
+
+void StringTable::rehash(size_t numSlots)
+{
+	m_slots.assign(numSlots, 0);
+
+	const size_t mask = numSlots - 1;
+	for (uint32_t i = 0; i < (uint32_t)m_entries.size(); i++)
+	{
+		size_t slot = m_entries[i].hash & mask;
+		while (m_slots[slot] != 0)
+			slot = (slot + 1) & mask;
+		m_slots[slot] = i + 1;
+	}
+}
+
+uint32_t StringTable::intern(const char *str, size_t length, bool copy)
+{
+	// at most half of the slots are used
+	if ((m_entries.size() + 1) * 2 > m_slots.size())
+		rehash(max(MinSlots, m_slots.size() * 2));
+
+	const uint64_t hash = hashString(str, length);
+	const size_t slot = findSlot(str, length, hash);
+	if (m_slots[slot] != 0)
+		return m_slots[slot] - 1;
+
+	Entry entry;
+	entry.str = copy ? copyString(str, length) : str;
+	entry.length = (uint32_t)length;
+	entry.offset = m_dataSize;
+	entry.hash = hash;
+
+	m_dataSize += (uint32_t)length + 1;
+	m_entries.push_back(entry);
+	m_slots[slot] = (uint32_t)m_entries.size();
+	return (uint32_t)m_entries.size() - 1;
+}
+
+uint32_t StringTable::find(const char *str, size_t length) const
+{
+	if (m_slots.empty())
+		return NotFound;
+
+	const size_t slot = findSlot(str, length, hashString(str, length));
+	return m_slots[slot] != 0 ? m_slots[slot] - 1 : NotFound;
+}
+
+string StringTable::data() const
+{
+	string data;
+	data.reserve(m_dataSize);
+
+	for (const auto &entry : m_entries)
+		data.append(entry.str, entry.length + 1);
+
+	return data;
+}
+
+size_t StringTable::memorySize() const
+{
+	size_t size = sizeof(StringTable) + m_entries.capacity() * sizeof(Entry) + m_slots.capacity() * sizeof(uint32_t);
+	size += m_chunks.size() * ChunkSize; // long strings are counted as chunks, they are rare
+	return size;
+}
+
+void StringTable::clear()
+{
+	m_entries.clear();
+	m_slots.clear();
+	m_dataSize = 0;
+	m_chunks.clear();
+	m_chunk = nullptr;
+	m_chunkUsed = 0;
+}
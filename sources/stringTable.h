@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Interned strings with stable ids, numbered in the order they are first added. Copies live in arena chunks, so neither ids nor
+// pointers change as the table grows, and equal strings compare by id.
+class StringTable
+{
+public:
+	static const uint32_t NotFound = UINT32_MAX;
+
+	StringTable() {}
+	explicit StringTable(const vector<string> &strings); // ids follow the order of the strings
+
+	StringTable(const StringTable&) = delete;
+	StringTable& operator=(const StringTable&) = delete;
+
+	// a string which is not copied must outlive the table
+	uint32_t intern(const char *str, size_t length, bool copy = true);
+	uint32_t intern(const char *str) { return intern(str, strlen(str)); }
+
+	uint32_t find(const char *str, size_t length) const;
+	uint32_t find(const char *str) const { return find(str, strlen(str)); }
+
+	const char* get(uint32_t id) const { return m_entries[id].str; }
+	size_t length(uint32_t id) const { return m_entries[id].length; }
+	size_t size() const { return m_entries.size(); }
+
+	// all strings in id order with a terminating zero each, the name table of a file
+	string data() const;
+	uint32_t offset(uint32_t id) const { return m_entries[id].offset; }
+
+	size_t memorySize() const;
+	void clear();
+
+private:
+	struct Entry
+	{
+		const char *str;
+		uint32_t length;
+		uint32_t offset;
+		uint64_t hash;
+	};
+
+	const char* copyString(const char *str, size_t length);
+	size_t findSlot(const char *str, size_t length, uint64_t hash) const;
+	void rehash(size_t numSlots);
+
+	vector<Entry> m_entries;
+	vector<uint32_t> m_slots; // open addressing, id + 1 or zero when empty
+	uint32_t m_dataSize = 0;
+
+	vector<unique_ptr<char[]>> m_chunks;
+	char *m_chunk = nullptr; // short strings are copied here
+	size_t m_chunkUsed = 0;
+};
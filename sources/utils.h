@@ -1,24 +1,41 @@
 #pragma once
 
+#include <maya/MGlobal.h>
+#include <maya/MPxCommand.h>
 #include <maya/MObjectArray.h>
 #include <maya/MPlug.h>
 #include <maya/MPlugArray.h>
-#include <maya/MAnimUtil.h>
+#include <maya/MObjectHandle.h>
 #include <maya/MFnAnimCurve.h>
+#include <maya/MAngle.h>
+#include <maya/MTime.h>
+#include <maya/MTimeArray.h>
+#include <maya/MDoubleArray.h>
 #include <maya/MFnDependencyNode.h>
+#include <maya/MItDependencyNodes.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgParser.h>
 
-#include <set>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <string>
-#include <chrono>
+#include <cstring>
+
+#include "clip.h"
 
 using namespace std;
 
 #define TO_MSTR(x) MString(to_string(x).c_str())
 
-const vector<string> AnimCurveTypes{ "animCurveTA", "animCurveTL", "animCurveTT", "animCurveTU", "animCurveUA", "animCurveUL", "animCurveUT", "animCurveUU" };
-const vector<string> TangentTypes{ "global", "fixed", "linear", "flat", "spline", "step", "slow", "fast", "clamped", "plateau", "stepnext", "auto" };
+// clips store MFnAnimCurve enum values as they are, the core library names them without Maya
+static_assert(InfinityConstant == MFnAnimCurve::kConstant && InfinityLinear == MFnAnimCurve::kLinear, "infinity types differ from MFnAnimCurve");
+static_assert(InfinityCycle == MFnAnimCurve::kCycle && InfinityCycleRelative == MFnAnimCurve::kCycleRelative &&
+	InfinityOscillate == MFnAnimCurve::kOscillate, "infinity types differ from MFnAnimCurve");
+static_assert(TangentFixed == MFnAnimCurve::kTangentFixed && TangentLinear == MFnAnimCurve::kTangentLinear &&
+	TangentFlat == MFnAnimCurve::kTangentFlat && TangentSpline == MFnAnimCurve::kTangentSmooth && TangentStep == MFnAnimCurve::kTangentStep &&
+	TangentClamped == MFnAnimCurve::kTangentClamped && TangentPlateau == MFnAnimCurve::kTangentPlateau &&
+	TangentStepNext == MFnAnimCurve::kTangentStepNext && TangentAuto == MFnAnimCurve::kTangentAuto, "tangent types differ from MFnAnimCurve");
 
 const map<string, MFnAnimCurve::AnimCurveType> AnimCurveTypesMap = {
 	{"animCurveTA", MFnAnimCurve::AnimCurveType::kAnimCurveTA},
@@ -45,12 +62,48 @@ const map<string, MFnAnimCurve::TangentType> TangentTypesMap = {
 	{"auto", MFnAnimCurve::TangentType::kTangentAuto},
 };
 
-inline chrono::steady_clock::time_point getMeasureTime() { return chrono::steady_clock::now(); }
+// sets the profile report as the command result and writes it to the report file if one is given
+inline void setProfileResult(const Profiler &profiler, const string &command, const MString &filePath, const MString &reportPath)
+{
+	if (!profiler.isEnabled())
+		return;
+
+	MPxCommand::setResult(MString(profiler.toJson(command, filePath.asChar()).c_str()));
+
+	if (reportPath.length() > 0 && !profiler.writeJson(command, filePath.asChar(), reportPath.asChar()))
+		MGlobal::displayWarning("Cannot write profile report '" + reportPath + "'");
+}
+
+// the flag sets the tolerance of every curve type, its typed flags such as -reduceAngular (-rda) override it
+inline void addToleranceFlags(MSyntax &syntax, const string &shortName, const string &longName)
+{
+	syntax.addFlag(shortName.c_str(), longName.c_str(), MSyntax::MArgType::kDouble);
+	syntax.addFlag((shortName + "a").c_str(), (longName + "Angular").c_str(), MSyntax::MArgType::kDouble);
+	syntax.addFlag((shortName + "l").c_str(), (longName + "Linear").c_str(), MSyntax::MArgType::kDouble);
+	syntax.addFlag((shortName + "u").c_str(), (longName + "Unitless").c_str(), MSyntax::MArgType::kDouble);
+}
 
-inline void measureTime(const string& name, const chrono::steady_clock::time_point& startTime)
+inline CurveTolerances getTolerances(const MArgParser &argParser, const string &shortName)
 {
-	const auto count = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startTime).count();
-	printf("%s: %.2fs", name.c_str(), count / 1000000.0);
+	CurveTolerances tolerances;
+
+	if (argParser.isFlagSet(shortName.c_str()))
+	{
+		double tolerance = 0;
+		argParser.getFlagArgument(shortName.c_str(), 0, tolerance);
+		tolerances.angular = tolerances.linear = tolerances.unitless = tolerance;
+	}
+
+	if (argParser.isFlagSet((shortName + "a").c_str()))
+		argParser.getFlagArgument((shortName + "a").c_str(), 0, tolerances.angular);
+
+	if (argParser.isFlagSet((shortName + "l").c_str()))
+		argParser.getFlagArgument((shortName + "l").c_str(), 0, tolerances.linear);
+
+	if (argParser.isFlagSet((shortName + "u").c_str()))
+		argParser.getFlagArgument((shortName + "u").c_str(), 0, tolerances.unitless);
+
+	return tolerances;
 }
 
 inline string getNodeLocalName(const MFnDependencyNode &nodeFn)
@@ -81,28 +134,311 @@ inline string replaceString(string subject, const string &search, const string &
 	return subject;
 }
 
-inline void findAnimationCurves(const MPlug& plug, MObjectArray& outAnimCurves)
+// returns L_/R_ or _L/_R counterpart of the name, or an empty string
+inline string getMirrorName(const string &name)
+{
+	const size_t n = name.length();
+	if (n < 2)
+		return string();
+
+	static const pair<const char*, const char*> prefixes[] = { {"L_", "R_"}, {"R_", "L_"}, {"l_", "r_"}, {"r_", "l_"} };
+	for (const auto &p : prefixes)
+	{
+		if (startsWith(name, p.first))
+			return p.second + name.substr(2);
+	}
+
+	static const pair<const char*, const char*> suffixes[] = { {"_L", "_R"}, {"_R", "_L"}, {"_l", "_r"}, {"_r", "_l"} };
+	for (const auto &p : suffixes)
+	{
+		if (endsWith(name, p.first))
+			return name.substr(0, n - 2) + p.second;
+	}
+
+	return string();
+}
+
+// Maps local names to nodes of every namespace in a single scene pass, where a namespace is a prefix like "char1:" or empty for the root namespace
+inline vector<unordered_map<string, MObject>> getNamespaceNodes(const vector<string> &namespaces)
+{
+	vector<unordered_map<string, MObject>> nodes(namespaces.size());
+
+	unordered_map<string, vector<size_t>> indices; // a namespace may be listed more than once
+	for (size_t i = 0; i < namespaces.size(); i++)
+		indices[namespaces[i]].push_back(i);
+
+	string ns;
+	for (MItDependencyNodes it; !it.isDone(); it.next())
+	{
+		MObject nodeObj = it.thisNode();
+		const MString name = MFnDependencyNode(nodeObj).name();
+		const char *str = name.asChar();
+
+		const char *separator = strrchr(str, ':');
+		const char *localName = separator ? separator + 1 : str;
+		ns.assign(str, localName - str);
+
+		const auto found = indices.find(ns);
+		if (found != indices.end())
+		{
+			for (size_t i : found->second)
+				nodes[i].emplace(localName, nodeObj);
+		}
+	}
+
+	return nodes;
+}
+
+// Maps plugs of the added nodes to the animation curves connected to them directly or through a unit conversion.
+// Each node's connections are walked once, so the cost is linear in the number of connections.
+class AnimCurveIndex
+{
+public:
+	void addNode(const MObject &nodeObj)
+	{
+		MObjectHandle handle(nodeObj);
+		vector<Node> &nodes = m_nodes[handle.hashCode()];
+		for (const auto &node : nodes)
+		{
+			if (node.handle == handle)
+				return;
+		}
+
+		nodes.push_back({ handle, vector<pair<MPlug, MObject>>() });
+		vector<pair<MPlug, MObject>> &curves = nodes.back().curves;
+
+		MPlugArray plugs;
+		MFnDependencyNode(nodeObj).getConnections(plugs);
+
+		for (unsigned int i = 0; i < plugs.length(); i++)
+		{
+			if (!plugs[i].isDestination())
+				continue;
+
+			MPlug source = plugs[i].source();
+			if (!source.isNull() && source.node().hasFn(MFn::kUnitConversion))
+				source = MFnDependencyNode(source.node()).findPlug("input", true).source();
+
+			if (!source.isNull() && source.node().hasFn(MFn::kAnimCurve))
+				curves.push_back(make_pair(plugs[i], source.node()));
+		}
+	}
+
+	// returns a null object if the plug is not animated
+	MObject find(const MPlug &plug) const
+	{
+		MObjectHandle handle(plug.node());
+		const auto found = m_nodes.find(handle.hashCode());
+		if (found == m_nodes.end())
+			return MObject();
+
+		for (const auto &node : found->second)
+		{
+			if (node.handle != handle)
+				continue;
+
+			for (const auto &plugCurve : node.curves)
+			{
+				if (plugCurve.first == plug)
+					return plugCurve.second;
+			}
+		}
+		return MObject();
+	}
+
+private:
+	// hash codes are not unique, nodes sharing one are told apart by their handles
+	struct Node
+	{
+		MObjectHandle handle;
+		vector<pair<MPlug, MObject>> curves;
+	};
+
+	unordered_map<unsigned int, vector<Node>> m_nodes;
+};
+
+// Indices [first, last) of the keys in [startFrame, endFrame], found by binary search as keys are sorted by time.
+// Times are in the unit of the curve.
+inline void findAnimCurveKeys(const MFnAnimCurve& acFn, double startFrame, double endFrame, unsigned int &first, unsigned int &last)
+{
+	const bool isUnitless = acFn.isUnitlessInput();
+	auto keyTime = [&](unsigned int i) { return isUnitless ? acFn.unitlessInput(i) : acFn.time(i).value(); };
+
+	// first key after the frame, or at or after it for the start
+	auto search = [&](double frame, bool isStart)
+	{
+		unsigned int found = 0;
+		for (unsigned int count = acFn.numKeys(); count > 0;)
+		{
+			const unsigned int step = count / 2;
+			const double t = keyTime(found + step);
+			if (isStart ? t < frame : t <= frame)
+			{
+				found += step + 1;
+				count -= step + 1;
+			}
+			else
+				count = step;
+		}
+		return found;
+	};
+
+	first = search(startFrame, true);
+	last = endFrame < startFrame ? first : search(endFrame, false);
+}
+
+// keys in [startFrame, endFrame] with absolute times
+inline void getAnimCurveFrameData(const MFnAnimCurve& acFn, CurveKeys &keys, double startFrame, double endFrame)
 {
-	MObjectArray animCurves;
-	set<const char*> skip;
+	const double coeff = isAngularCurveType(acFn.animCurveType()) ? RadiansToDegrees : 1;
+	const bool isUnitless = acFn.isUnitlessInput();
+	const bool isWeighted = acFn.isWeighted();
+
+	keys.clear();
+
+	unsigned int first, last;
+	findAnimCurveKeys(acFn, startFrame, endFrame, first, last);
 
-	if (MAnimUtil::findAnimation(plug, animCurves))
+	for (unsigned int i = first; i < last; i++)
 	{
-		for (int k = 0; k < animCurves.length(); k++)
+		const double t = isUnitless ? acFn.unitlessInput(i) : acFn.time(i).value();
+
+		const auto itt = acFn.inTangentType(i);
+		const auto ott = acFn.outTangentType(i);
+
+		if (itt == MFnAnimCurve::kTangentFixed || ott == MFnAnimCurve::kTangentFixed)
 		{
-			MFnAnimCurve acFn(animCurves[k]);
-			MPlugArray destPlugs;
-			if (acFn.findPlug("output", true).destinationsWithConversions(destPlugs))
+			FixedTangent ft = {};
+			ft.key = (uint32_t)keys.size();
+			ft.weightsLocked = acFn.weightsLocked(i);
+			ft.tangentsLocked = acFn.tangentsLocked(i);
+
+			MAngle ia, oa;
+			acFn.getTangent(i, ia, ft.inWeight, true);
+			acFn.getTangent(i, oa, ft.outWeight, false);
+			ft.inAngle = ia.value();
+			ft.outAngle = oa.value();
+
+			if (isWeighted)
 			{
-				for (int j = 0; j < destPlugs.length(); j++)
-				{
-					if (destPlugs[j].node() == plug.node() && skip.find(acFn.name().asChar()) == skip.end())
-					{
-						outAnimCurves.append(animCurves[k]);
-						skip.emplace(acFn.name().asChar());
-					}
-				}
+				acFn.getTangent(i, ft.inX, ft.inY, true);
+				acFn.getTangent(i, ft.outX, ft.outY, false);
 			}
+
+			keys.fixedTangents.push_back(ft);
+		}
+
+		keys.times.push_back(t);
+		keys.values.push_back(acFn.value(i) * coeff);
+		keys.inTangentTypes.push_back((uint8_t)itt);
+		keys.outTangentTypes.push_back((uint8_t)ott);
+	}
+}
+
+// the most frequent tangent type is given to all keys at insertion, the rest are set key by key
+inline MFnAnimCurve::TangentType getCommonTangentType(const uint8_t *types, size_t numKeys)
+{
+	size_t counts[256] = {};
+	for (size_t i = 0; i < numKeys; i++)
+		counts[types[i]]++;
+
+	size_t common = 0;
+	for (size_t i = 1; i < 256; i++)
+	{
+		if (counts[i] > counts[common])
+			common = i;
+	}
+	return (MFnAnimCurve::TangentType)common;
+}
+
+// without keepExistingKeys the keys of the curve in the time range of the new keys are replaced
+inline void setAnimCurveData(MFnAnimCurve& acFn, const CurveData& curve, MAnimCurveChange *animChange, double timeOffset = 0, bool keepExistingKeys = true)
+{
+	if (curve.numKeys == 0)
+		return;
+
+	const double coeff = isAngularCurveType(acFn.animCurveType()) ? DegreesToRadians : 1;
+
+	const bool isWeighted = curve.weighted;
+	acFn.setIsWeighted(isWeighted, animChange);
+
+	const auto unit = (MTime::Unit)curve.unit;
+	const bool isTimeInput = acFn.isTimeInput();
+	const bool hasKeys = acFn.numKeys() > 0;
+
+	const auto commonItt = getCommonTangentType(curve.inTangentTypes, curve.numKeys);
+	const auto commonOtt = getCommonTangentType(curve.outTangentTypes, curve.numKeys);
+
+	const unsigned int numKeys = (unsigned int)curve.numKeys;
+
+	// decode all keys first, so tangents are computed once for the whole curve
+	MDoubleArray values(numKeys);
+	for (unsigned int i = 0; i < numKeys; i++)
+		values[i] = curve.values[i] * coeff;
+
+	if (isTimeInput)
+	{
+		MTimeArray times(numKeys, MTime(0.0, unit));
+		for (unsigned int i = 0; i < numKeys; i++)
+			times[i].setValue(curve.times[i] + timeOffset);
+
+		acFn.addKeys(&times, &values, commonItt, commonOtt, keepExistingKeys, animChange);
+	}
+	else
+	{
+		for (unsigned int i = 0; i < numKeys; i++)
+			acFn.addKey(curve.times[i] + timeOffset, values[i], commonItt, commonOtt, animChange);
+	}
+
+	auto keyIndex = [&](unsigned int i)
+	{
+		unsigned int idx = i;
+		if (hasKeys)
+		{
+			if (isTimeInput)
+				acFn.find(MTime(curve.times[i] + timeOffset, unit), idx);
+			else
+				acFn.find(curve.times[i] + timeOffset, idx);
 		}
+		return idx;
+	};
+
+	const FixedTangent *fixed = curve.fixedTangents;
+	const FixedTangent *fixedEnd = curve.fixedTangents + curve.numFixedTangents;
+
+	for (unsigned int i = 0; i < numKeys; i++)
+	{
+		const auto itt = (MFnAnimCurve::TangentType)curve.inTangentTypes[i];
+		const auto ott = (MFnAnimCurve::TangentType)curve.outTangentTypes[i];
+
+		const bool isFixed = fixed != fixedEnd && fixed->key == i;
+		if (!isFixed && itt == commonItt && ott == commonOtt)
+			continue;
+
+		const unsigned int idx = keyIndex(i);
+
+		if (isFixed)
+		{
+			acFn.setWeightsLocked(idx, false, animChange);
+			acFn.setTangentsLocked(idx, false, animChange);
+			acFn.setTangent(idx, MAngle(fixed->inAngle), fixed->inWeight, true, animChange);
+			acFn.setTangent(idx, MAngle(fixed->outAngle), fixed->outWeight, false, animChange);
+
+			// keys pasted from a non-weighted curve have no tangent vectors, their angles and weights are kept
+			if (isWeighted && fixed->inX != 0)
+				acFn.setTangent(idx, fixed->inX, fixed->inY, true, animChange);
+			if (isWeighted && fixed->outX != 0)
+				acFn.setTangent(idx, fixed->outX, fixed->outY, false, animChange);
+
+			acFn.setWeightsLocked(idx, fixed->weightsLocked != 0, animChange);
+			acFn.setTangentsLocked(idx, fixed->tangentsLocked != 0, animChange);
+			fixed++;
+		}
+
+		if (itt != commonItt || isFixed)
+			acFn.setInTangentType(idx, itt, animChange);
+
+		if (ott != commonOtt || isFixed)
+			acFn.setOutTangentType(idx, ott, animChange);
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,328 @@
+// Encode/decode throughput of the clip formats over a matrix of synthetic clips, and sampling of the decoded curves.
+// Usage: animClipBench [--quick] [--keep] [--corpus dir] [--output results.json]
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+#include "rapidjson/document.h"
+#include "rapidjson/istreamwrapper.h"
+#include "rapidjson/filewritestream.h"
+#include "rapidjson/prettywriter.h"
+
+#include "clip.h"
+#include "jsonClip.h"
+#include "curveEvaluator.h"
+#include "syntheticClip.h"
+
+using namespace std;
+using namespace rapidjson;
+
+struct PhaseResult
+{
+	string format;
+	string phase;
+	SyntheticClipParams params;
+	size_t numKeys;
+	size_t bytes;
+	double seconds;
+	double peakRssMB;
+};
+
+// peak resident set size is reset before each phase where the OS allows it
+static void resetPeakRss()
+{
+#ifndef _WIN32
+	FILE *f = fopen("/proc/self/clear_refs", "w");
+	if (f)
+	{
+		fputs("5", f);
+		fclose(f);
+	}
+#endif
+}
+
+static double getPeakRssMB()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+	return 0;
+#else
+	double peak = 0;
+	FILE *f = fopen("/proc/self/status", "r");
+	if (f)
+	{
+		char line[256];
+		while (fgets(line, sizeof(line), f))
+		{
+			if (strncmp(line, "VmHWM:", 6) == 0)
+				peak = atof(line + 6) / 1024.0;
+		}
+		fclose(f);
+	}
+	return peak;
+#endif
+}
+
+static size_t getFileSize(const string &filePath)
+{
+	MappedFile file;
+	return file.open(filePath.c_str()) ? file.size() : 0;
+}
+
+static PhaseResult measure(const string &format, const string &phase, const SyntheticClipParams &params, size_t numKeys, const function<void()> &run)
+{
+	resetPeakRss();
+	const auto startTime = chrono::steady_clock::now();
+	run();
+	const double seconds = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startTime).count() / 1000000.0;
+
+	PhaseResult result;
+	result.format = format;
+	result.phase = phase;
+	result.params = params;
+	result.numKeys = numKeys;
+	result.bytes = 0;
+	result.seconds = seconds;
+	result.peakRssMB = getPeakRssMB();
+	return result;
+}
+
+static void printResult(const PhaseResult &r)
+{
+	const double mb = r.bytes / (1024.0 * 1024.0);
+	printf("%-6s %-9s %5d nodes %5d keys %s fixed %.2f: %8.2f MB %8.3fs %9.1f MB/s %12.0f keys/s peak %8.1f MB\n",
+		r.format.c_str(), r.phase.c_str(), r.params.numNodes, r.params.numKeys, r.params.weighted ? "weighted  " : "unweighted", r.params.fixedTangentDensity,
+		mb, r.seconds, mb / max(r.seconds, 1e-9), r.numKeys / max(r.seconds, 1e-9), r.peakRssMB);
+}
+
+static bool writeResults(const vector<PhaseResult> &results, const string &filePath)
+{
+	FILE *f = fopen(filePath.c_str(), "wb");
+	if (!f)
+		return false;
+
+	char buffer[65536];
+	FileWriteStream stream(f, buffer, sizeof(buffer));
+	PrettyWriter<FileWriteStream> writer(stream);
+
+	writer.StartObject();
+	writer.Key("benchmark");
+	writer.String("animClipBench");
+	writer.Key("version");
+	writer.Int(1);
+	writer.Key("results");
+	writer.StartArray();
+
+	for (const auto &r : results)
+	{
+		writer.StartObject();
+		writer.Key("format");
+		writer.String(r.format.c_str());
+		writer.Key("phase");
+		writer.String(r.phase.c_str());
+		writer.Key("nodes");
+		writer.Int(r.params.numNodes);
+		writer.Key("curvesPerNode");
+		writer.Int(r.params.numCurves);
+		writer.Key("keysPerCurve");
+		writer.Int(r.params.numKeys);
+		writer.Key("weighted");
+		writer.Bool(r.params.weighted);
+		writer.Key("fixedTangentDensity");
+		writer.Double(r.params.fixedTangentDensity);
+		writer.Key("keys");
+		writer.Uint64(r.numKeys);
+		writer.Key("bytes");
+		writer.Uint64(r.bytes);
+		writer.Key("seconds");
+		writer.Double(r.seconds);
+		writer.Key("mbPerSecond");
+		writer.Double(r.bytes / (1024.0 * 1024.0) / max(r.seconds, 1e-9));
+		writer.Key("keysPerSecond");
+		writer.Double(r.numKeys / max(r.seconds, 1e-9));
+		writer.Key("peakRssMB");
+		writer.Double(r.peakRssMB);
+		writer.EndObject();
+	}
+
+	writer.EndArray();
+	writer.EndObject();
+	stream.Flush();
+
+	const bool ok = !ferror(f);
+	fclose(f);
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	bool quick = false;
+	bool keep = false;
+	string corpusDir = ".";
+	string outputPath = "animClipBench.json";
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--quick") == 0)
+			quick = true;
+		else if (strcmp(argv[i], "--keep") == 0)
+			keep = true;
+		else if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc)
+			corpusDir = argv[++i];
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			outputPath = argv[++i];
+		else
+		{
+			printf("Usage: animClipBench [--quick] [--keep] [--corpus dir] [--output results.json]\n");
+			return 1;
+		}
+	}
+
+	const vector<int> nodeCounts = quick ? vector<int>{ 10, 100 } : vector<int>{ 10, 100, 400 };
+	const vector<int> keyCounts = quick ? vector<int>{ 24, 240 } : vector<int>{ 24, 240, 1200 };
+	const vector<double> fixedDensities{ 0, 0.5 };
+
+	vector<PhaseResult> results;
+
+	for (int numNodes : nodeCounts)
+	{
+		for (int numKeys : keyCounts)
+		{
+			for (bool weighted : { false, true })
+			{
+				for (double fixedDensity : fixedDensities)
+				{
+					SyntheticClipParams params;
+					params.numNodes = numNodes;
+					params.numKeys = numKeys;
+					params.weighted = weighted;
+					params.fixedTangentDensity = fixedDensity;
+
+					const SyntheticClip clip = makeSyntheticClip(params);
+					const size_t totalKeys = getNumKeys(clip);
+
+					const string name = corpusDir + "/clip_n" + to_string(numNodes) + "_k" + to_string(numKeys) + (weighted ? "_w" : "") + "_f" + to_string(int(fixedDensity * 100));
+					const string jsonPath = name + ".json";
+					const string binaryPath = name + BinaryClipExtension;
+					const string compressedPath = name + "_lz4.json";
+
+					// json
+					vector<PhaseResult> caseResults;
+					caseResults.push_back(measure("json", "serialize", params, totalKeys, [&]() { writeSyntheticClip(clip, JsonClipFormat, jsonPath); }));
+
+					{
+						Document doc;
+						caseResults.push_back(measure("json", "parse", params, totalKeys, [&]() {
+							ifstream ifs(jsonPath);
+							IStreamWrapper isw(ifs);
+							doc.ParseStream(isw);
+						}));
+
+						Clip decoded;
+						string error;
+						caseResults.push_back(measure("json", "walk", params, totalKeys, [&]() { decodeJsonClip(doc, decoded, error); }));
+					}
+
+					caseResults.push_back(measure("json", "load", params, totalKeys, [&]() {
+						Clip loaded;
+						string error;
+						loaded.load(jsonPath.c_str(), error);
+					}));
+
+					for (auto &r : caseResults)
+						r.bytes = getFileSize(jsonPath);
+
+					// binary
+					const size_t jsonResults = caseResults.size();
+					caseResults.push_back(measure("binary", "serialize", params, totalKeys, [&]() { writeSyntheticClip(clip, BinaryClipFormat, binaryPath); }));
+					caseResults.push_back(measure("binary", "load", params, totalKeys, [&]() {
+						Clip loaded;
+						string error;
+						loaded.load(binaryPath.c_str(), error);
+					}));
+
+					{
+						Clip loaded;
+						string error;
+						loaded.load(binaryPath.c_str(), error);
+
+						// every curve at every quarter frame of the clip
+						vector<double> times;
+						for (double t = 0; t < numKeys * 2; t += 0.25)
+							times.push_back(t);
+
+						caseResults.push_back(measure("binary", "sample", params, totalKeys, [&]() {
+							vector<CurveEvaluator> evaluators;
+							for (const auto &node : loaded.nodes())
+							{
+								for (const auto &curve : node.curves)
+								{
+									evaluators.emplace_back();
+									evaluators.back().prepare(curve.data, false);
+								}
+							}
+
+							vector<const CurveEvaluator*> curves;
+							for (const auto &evaluator : evaluators)
+								curves.push_back(&evaluator);
+
+							vector<double> values(curves.size() * times.size());
+							sampleCurves(curves, times.data(), times.size(), values.data());
+						}));
+					}
+
+					for (size_t i = jsonResults; i < caseResults.size(); i++)
+						caseResults[i].bytes = getFileSize(binaryPath);
+
+					// block compressed json
+					const size_t binaryResults = caseResults.size();
+					caseResults.push_back(measure("json.lz4", "serialize", params, totalKeys, [&]() { writeSyntheticClip(clip, JsonClipFormat, compressedPath, true); }));
+					caseResults.push_back(measure("json.lz4", "load", params, totalKeys, [&]() {
+						Clip loaded;
+						string error;
+						loaded.load(compressedPath.c_str(), error);
+					}));
+
+					for (size_t i = binaryResults; i < caseResults.size(); i++)
+						caseResults[i].bytes = getFileSize(compressedPath);
+
+					for (const auto &r : caseResults)
+					{
+						printResult(r);
+						results.push_back(r);
+					}
+
+					if (!keep)
+					{
+						remove(jsonPath.c_str());
+						remove(binaryPath.c_str());
+						remove(compressedPath.c_str());
+					}
+				}
+			}
+		}
+	}
+
+	if (!writeResults(results, outputPath))
+	{
+		printf("Cannot write '%s'\n", outputPath.c_str());
+		return 1;
+	}
+
+	printf("Results are written to '%s'\n", outputPath.c_str());
+	return 0;
+}
@@ -0,0 +1,1425 @@
+// Headless round trip test of the clip formats. Runs without Maya.
+
+#include <cstddef>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "clip.h"
+#include "binaryClip.h"
+#include "clipCache.h"
+#include "keyReduction.h"
+#include "curveEvaluator.h"
+#include "curvePaste.h"
+#include "keyJournal.h"
+#include "blockFile.h"
+#include "lz4Block.h"
+#include "parallel.h"
+#include "syntheticClip.h"
+
+using namespace std;
+
+static int failures = 0;
+
+#define CHECK(x) do { if (!(x)) { printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #x); failures++; } } while (0)
+
+static bool isClose(double a, double b)
+{
+	return fabs(a - b) <= 1e-12 * max(1.0, fabs(a));
+}
+
+// quantized values are restored within their tolerance, the rest exactly
+static bool isWithin(double expected, double actual, double tolerance)
+{
+	return tolerance > 0 ? fabs(expected - actual) <= tolerance : isClose(expected, actual);
+}
+
+static void compareClip(const SyntheticClip &nodes, const Clip &clip)
+{
+	CHECK(clip.nodes().size() == nodes.size());
+
+	for (const auto &node : nodes)
+	{
+		const ClipNode *clipNode = clip.findNode(node.name);
+		CHECK(clipNode != nullptr);
+		if (!clipNode)
+			continue;
+
+		CHECK(clipNode->curves.size() == node.curves.size());
+		CHECK(clipNode->channels.size() == node.channels.size());
+		CHECK(clipNode->statics.size() == node.statics.size());
+
+		for (size_t c = 0; c < node.curves.size() && c < clipNode->curves.size(); c++)
+		{
+			const CurveData &expected = node.curves[c].data;
+			const CurveData &actual = clipNode->curves[c].data;
+
+			CHECK(node.curves[c].attr == clipNode->curves[c].attr);
+			CHECK(expected.weighted == actual.weighted);
+			CHECK(expected.preInfinity == actual.preInfinity);
+			CHECK(expected.postInfinity == actual.postInfinity);
+			CHECK(expected.unit == actual.unit);
+			CHECK(expected.numKeys == actual.numKeys);
+			CHECK(expected.numFixedTangents == actual.numFixedTangents);
+
+			if (expected.numKeys != actual.numKeys || expected.numFixedTangents != actual.numFixedTangents)
+				continue;
+
+			bool keysEqual = true;
+			for (size_t k = 0; k < expected.numKeys; k++)
+			{
+				keysEqual = keysEqual && isClose(expected.times[k], actual.times[k]) && isWithin(expected.values[k], actual.values[k], expected.tolerance) &&
+					expected.inTangentTypes[k] == actual.inTangentTypes[k] && expected.outTangentTypes[k] == actual.outTangentTypes[k];
+			}
+			CHECK(keysEqual);
+
+			bool tangentsEqual = true;
+			for (size_t k = 0; k < expected.numFixedTangents; k++)
+			{
+				const FixedTangent &a = expected.fixedTangents[k];
+				const FixedTangent &b = actual.fixedTangents[k];
+
+				tangentsEqual = tangentsEqual && a.key == b.key && a.weightsLocked == b.weightsLocked && a.tangentsLocked == b.tangentsLocked &&
+					isClose(a.inAngle, b.inAngle) && isClose(a.outAngle, b.outAngle) && isClose(a.inWeight, b.inWeight) && isClose(a.outWeight, b.outWeight) &&
+					isClose(a.inX, b.inX) && isClose(a.inY, b.inY) && isClose(a.outX, b.outX) && isClose(a.outY, b.outY);
+			}
+			CHECK(tangentsEqual);
+		}
+
+		for (size_t c = 0; c < node.channels.size() && c < clipNode->channels.size(); c++)
+		{
+			const ChannelData &expected = node.channels[c].data;
+			const ChannelData &actual = clipNode->channels[c].data;
+
+			CHECK(node.channels[c].attr == clipNode->channels[c].attr);
+			CHECK(expected.unit == actual.unit && isClose(expected.start, actual.start) && isClose(expected.step, actual.step));
+			CHECK(expected.numValues == actual.numValues);
+
+			bool valuesEqual = expected.numValues == actual.numValues;
+			for (size_t k = 0; k < expected.numValues && valuesEqual; k++)
+				valuesEqual = isWithin(expected.values[k], actual.values[k], expected.tolerance);
+			CHECK(valuesEqual);
+		}
+
+		for (size_t s = 0; s < node.statics.size() && s < clipNode->statics.size(); s++)
+		{
+			CHECK(node.statics[s].first == clipNode->statics[s].attr);
+			CHECK(isClose(node.statics[s].second, clipNode->statics[s].value));
+		}
+	}
+}
+
+static double getSeconds(const chrono::steady_clock::time_point &startTime)
+{
+	return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startTime).count() / 1000000.0;
+}
+
+static size_t getFileSize(const string &filePath)
+{
+	MappedFile file;
+	return file.open(filePath.c_str()) ? file.size() : 0;
+}
+
+static void testRoundTrip(ClipFormat format, int numNodes, int numCurves, int numKeys, bool weighted, int numChannels = 0)
+{
+	const string filePath = string("animClipCoreTest") + (format == BinaryClipFormat ? BinaryClipExtension : ".json");
+
+	SyntheticClipParams params;
+	params.numNodes = numNodes;
+	params.numCurves = numCurves;
+	params.numKeys = numKeys;
+	params.weighted = weighted;
+	params.numChannels = numChannels;
+	params.fixedTangentDensity = 0.3;
+	const SyntheticClip nodes = makeSyntheticClip(params);
+
+	auto startTime = chrono::steady_clock::now();
+	CHECK(writeSyntheticClip(nodes, format, filePath));
+	const double writeTime = getSeconds(startTime);
+
+	startTime = chrono::steady_clock::now();
+	Clip clip;
+	string error;
+	CHECK(clip.load(filePath.c_str(), error));
+	const double readTime = getSeconds(startTime);
+
+	compareClip(nodes, clip);
+
+	const double megabytes = getFileSize(filePath) / (1024.0 * 1024.0);
+	printf("%-6s %4d nodes x %3d curves x %5d keys%s%s: %8.2f MB, write %7.3fs (%7.1f MB/s), read %7.3fs (%7.1f MB/s)\n",
+		format == BinaryClipFormat ? "binary" : "json", numNodes, numCurves, numKeys, weighted ? " (weighted)" : "", numChannels ? " (baked)" : "", megabytes,
+		writeTime, megabytes / max(writeTime, 1e-6), readTime, megabytes / max(readTime, 1e-6));
+
+	remove(filePath.c_str());
+}
+
+static void writeFile(const string &filePath, const string &text)
+{
+	FILE *f = fopen(filePath.c_str(), "wb");
+	fwrite(text.data(), 1, text.size(), f);
+	fclose(f);
+}
+
+static void testStringTable()
+{
+	StringTable table;
+	const uint32_t tx = table.intern("tx");
+	const uint32_t ty = table.intern("ty");
+	const char *txString = table.get(tx);
+
+	CHECK(tx == 0 && ty == 1 && table.intern("tx") == tx);
+	CHECK(table.find("ty") == ty && table.find("tz") == StringTable::NotFound && table.find("t", 1) == StringTable::NotFound);
+
+	// ids and pointers stay valid while the table grows, long strings included
+	const string longName(10000, 'x');
+	for (int i = 0; i < 5000; i++)
+		table.intern(("ctrl" + to_string(i)).c_str());
+	const uint32_t longId = table.intern(longName.c_str(), longName.size());
+
+	CHECK(table.get(tx) == txString && table.find("ctrl4999") == 5001 && table.get(longId) == longName && table.length(longId) == longName.size());
+
+	// strings which are not copied are referenced
+	const char external[] = "ry";
+	CHECK(table.get(table.intern(external, 2, false)) == external);
+
+	const string data = table.data();
+	CHECK(table.offset(tx) == 0 && table.offset(ty) == 3 && strcmp(data.c_str() + table.offset(longId), longName.c_str()) == 0);
+
+	CHECK(findTangentType("spline") == 4 && findTangentType("stepnext", 4) == 5 && findTangentType("bogus") == -1);
+
+	// clip names are interned, so equal attributes of all nodes share an id
+	SyntheticClipParams params;
+	params.numNodes = 3;
+	const SyntheticClip nodes = makeSyntheticClip(params);
+
+	for (ClipFormat format : { JsonClipFormat, BinaryClipFormat })
+	{
+		const string filePath = format == JsonClipFormat ? "animClipCoreTestNames.json" : "animClipCoreTestNames" + BinaryClipExtension;
+		CHECK(writeSyntheticClip(nodes, format, filePath));
+
+		Clip clip;
+		string error;
+		CHECK(clip.load(filePath.c_str(), error));
+
+		const ClipNode *first = clip.findNode(nodes[0].name);
+		const ClipNode *last = clip.findNode(nodes[2].name);
+		CHECK(first && last && first->curves[1].attrId == last->curves[1].attrId && first->curves[0].attrId != first->curves[1].attrId);
+		CHECK(first && strcmp(clip.names().get(first->curves[1].attrId), first->curves[1].attr) == 0 && clip.names().get(first->nameId) == first->name);
+		CHECK(!clip.findNode("missing"));
+
+		remove(filePath.c_str());
+	}
+}
+
+static void testCorruptedBinary()
+{
+	const string filePath = "animClipCoreTestCorrupted" + BinaryClipExtension;
+	CHECK(writeSyntheticClip(makeSyntheticClip(SyntheticClipParams()), BinaryClipFormat, filePath));
+
+	// drop the footer
+	vector<char> data;
+	{
+		MappedFile file;
+		CHECK(file.open(filePath.c_str()));
+		data.assign(file.data(), file.data() + file.size() - 8);
+	}
+
+	writeFile(filePath, string(data.begin(), data.end()));
+
+	Clip clip;
+	string error;
+	CHECK(!clip.load(filePath.c_str(), error));
+	CHECK(!error.empty());
+
+	// a tangent type out of range, then fixed tangents out of key order
+	SyntheticClipParams params;
+	params.fixedTangentDensity = 0.2;
+	const SyntheticClip nodes = makeSyntheticClip(params);
+
+	for (int corruption = 0; corruption < 2; corruption++)
+	{
+		CHECK(writeSyntheticClip(nodes, BinaryClipFormat, filePath));
+		{
+			Clip validClip;
+			CHECK(validClip.load(filePath.c_str(), error));
+
+			const ClipNode *node = validClip.findNode(nodes[0].name);
+			CHECK(node && node->curves[0].data.numFixedTangents > 1);
+			if (!node || node->curves[0].data.numFixedTangents < 2)
+				break;
+
+			const CurveData &curve = node->curves[0].data;
+			const char *fileData = validClip.file().data();
+			data.assign(fileData, fileData + validClip.file().size());
+
+			if (corruption == 0)
+				data[(const char*)curve.inTangentTypes - fileData] = TangentAuto + 1;
+			else
+				memcpy(&data[(const char*)&curve.fixedTangents[1] - fileData], &curve.fixedTangents[0].key, sizeof(uint32_t));
+		}
+		writeFile(filePath, string(data.begin(), data.end()));
+
+		Clip corruptedClip;
+		CHECK(!corruptedClip.load(filePath.c_str(), error) && error.find("Corrupted binary clip") != string::npos);
+	}
+
+	remove(filePath.c_str());
+}
+
+static void testJsonInSitu()
+{
+	const string filePath = "animClipCoreTestInSitu.json";
+
+	// escaped names are unescaped in place, the file ends right after the last brace
+	writeFile(filePath, "{\"ns:\\u0041rm_L\":{\"animation\":{\"tx\":{\"data\":[[1,2,\"auto\",\"auto\"]]}},\"static\":{\"ro\":3}}}");
+	{
+		Clip clip;
+		string error;
+		CHECK(clip.load(filePath.c_str(), error));
+
+		const ClipNode *node = clip.findNode("ns:Arm_L");
+		CHECK(node && node->curves.size() == 1 && node->statics.size() == 1);
+		if (node && node->curves.size() == 1 && node->statics.size() == 1)
+		{
+			CHECK(string(node->curves[0].attr) == "tx");
+			CHECK(node->curves[0].data.numKeys == 1 && node->curves[0].data.values[0] == 2);
+			CHECK(string(node->statics[0].attr) == "ro" && node->statics[0].value == 3);
+		}
+	}
+
+	// the source file is never modified
+	MappedFile file;
+	CHECK(file.open(filePath.c_str()));
+	CHECK(file.isOpen() && string(file.data(), 4) == "{\"ns");
+	file.close();
+
+	// unknown members are skipped, weighted may follow the data
+	writeFile(filePath, "{\"n\":{\"others\":{\"a\":[1,{}]},\"animation\":{\"tx\":{\"data\":[[1,2,\"fixed\",\"auto\",true,false,1,2,3,4,5,6,7,8]],\"x\":[],\"weighted\":true}}}}");
+	{
+		Clip clip;
+		string error;
+		CHECK(clip.load(filePath.c_str(), error));
+
+		const ClipNode *node = clip.findNode("n");
+		CHECK(node && node->curves.size() == 1);
+		if (node && node->curves.size() == 1)
+		{
+			const CurveData &curve = node->curves[0].data;
+			CHECK(curve.weighted && curve.numFixedTangents == 1);
+			CHECK(curve.fixedTangents[0].weightsLocked && !curve.fixedTangents[0].tangentsLocked && curve.fixedTangents[0].outY == 8);
+		}
+	}
+
+	writeFile(filePath, "{\"n\":{\"animation\":{\"tx\":{\"data\":[[1,2,\"fixed\",\"auto\",true,false,1,2,3,4]],\"weighted\":true}}}}");
+	{
+		Clip clip;
+		string error;
+		CHECK(!clip.load(filePath.c_str(), error));
+		CHECK(error.find("n.tx") != string::npos);
+	}
+
+	writeFile(filePath, "{\"node\":{\"animation\":{\"tx\":{\"data\":[[1,2");
+	{
+		Clip clip;
+		string error;
+		CHECK(!clip.load(filePath.c_str(), error));
+		CHECK(!error.empty());
+	}
+
+	remove(filePath.c_str());
+}
+
+static void testNodeFilter(ClipFormat format)
+{
+	const string filePath = string("animClipCoreTestFilter") + (format == BinaryClipFormat ? BinaryClipExtension : ".json");
+
+	SyntheticClipParams params;
+	params.fixedTangentDensity = 0.3;
+	const SyntheticClip nodes = makeSyntheticClip(params);
+	CHECK(writeSyntheticClip(nodes, format, filePath));
+
+	const string selected = nodes[3].name;
+	int calls = 0;
+
+	Clip clip;
+	string error;
+	CHECK(clip.load(filePath.c_str(), error, nullptr, [&](const char *name) { calls++; return selected == name; }));
+	CHECK(calls == (int)nodes.size());
+	CHECK(clip.nodes().size() == 1);
+	CHECK(clip.findNode(selected) && !clip.findNode(nodes[0].name));
+	compareClip(SyntheticClip(1, nodes[3]), clip);
+
+	remove(filePath.c_str());
+}
+
+static void testClipCache()
+{
+	const string filePaths[] = { "animClipCoreTestCache0.json", "animClipCoreTestCache1.json", "animClipCoreTestCache2" + BinaryClipExtension };
+	for (const auto &filePath : filePaths)
+		CHECK(writeSyntheticClip(makeSyntheticClip(SyntheticClipParams()), getClipFormat(filePath), filePath));
+
+	ClipCache cache;
+	string error;
+
+	auto clip = cache.load(filePaths[0].c_str(), error);
+	CHECK(clip && cache.load(filePaths[0].c_str(), error) == clip);
+	CHECK(cache.hits() == 1 && cache.misses() == 1);
+	CHECK(cache.find(filePaths[0].c_str()) == clip && !cache.find(filePaths[1].c_str()) && cache.hits() == 1);
+	CHECK(cache.memorySize() >= clip->memorySize() && clip->memorySize() > getFileSize(filePaths[0]));
+
+	// a changed file is loaded again
+	SyntheticClipParams params;
+	params.numNodes = 3;
+	CHECK(writeSyntheticClip(makeSyntheticClip(params), JsonClipFormat, filePaths[0]));
+	CHECK(!cache.find(filePaths[0].c_str()));
+	auto changedClip = cache.load(filePaths[0].c_str(), error);
+	CHECK(changedClip && changedClip != clip && changedClip->nodes().size() == 3);
+	CHECK(clip->nodes().size() == 10); // still usable after being replaced
+	CHECK(cache.entries().size() == 1);
+
+	// least recently used clips are evicted
+	cache.clear();
+	auto clip0 = cache.load(filePaths[0].c_str(), error);
+	auto clip1 = cache.load(filePaths[1].c_str(), error);
+	cache.setBudget(clip0->memorySize() + clip1->memorySize());
+	CHECK(cache.load(filePaths[0].c_str(), error) == clip0);
+	auto clip2 = cache.load(filePaths[2].c_str(), error);
+	CHECK(clip2 && cache.memorySize() <= cache.budget());
+	CHECK(cache.entries().size() >= 1 && cache.entries()[0].filePath == filePaths[2]);
+	CHECK(cache.load(filePaths[1].c_str(), error) != clip1);
+
+	// files over the budget are loaded filtered and not cached
+	cache.clear();
+	cache.setBudget(1024);
+	auto filtered = cache.load(filePaths[1].c_str(), error, nullptr, [](const char*) { return false; });
+	CHECK(filtered && filtered->nodes().empty() && cache.entries().empty() && !cache.find(filePaths[1].c_str()));
+
+	// loaded from several threads at once, every thread gets the file's clip and the cache stays consistent
+	cache.clear();
+	cache.setBudget(DefaultClipCacheBudget);
+	const uint64_t numLoads = cache.hits() + cache.misses();
+	vector<shared_ptr<const Clip>> loaded(64);
+	parallelFor(loaded.size(), 8, [&](size_t i)
+	{
+		string threadError;
+		loaded[i] = cache.load(filePaths[i % 3].c_str(), threadError);
+		cache.entries();
+	});
+	for (size_t i = 0; i < loaded.size(); i++)
+		CHECK(loaded[i] && loaded[i]->nodes().size() == (i % 3 == 0 ? 3u : 10u));
+	CHECK(cache.entries().size() == 3 && cache.hits() + cache.misses() == numLoads + loaded.size());
+
+	// filtered clips are cached by their filter key, a cached whole clip serves any filter
+	cache.clear();
+	auto acceptFirst = [](const char *name) { return string(name) == "R_ctrl0"; };
+	auto firstOnly = cache.load(filePaths[1].c_str(), error, nullptr, acceptFirst, "R_ctrl0");
+	CHECK(firstOnly && firstOnly->nodes().size() == 1 && firstOnly->skippedNodes().size() == 9);
+	CHECK(cache.load(filePaths[1].c_str(), error, nullptr, acceptFirst, "R_ctrl0") == firstOnly);
+	CHECK(cache.find(filePaths[1].c_str(), "R_ctrl0") == firstOnly && !cache.find(filePaths[1].c_str()));
+	CHECK(cache.entries().size() == 1 && cache.entries()[0].isFiltered);
+
+	auto whole = cache.load(filePaths[1].c_str(), error);
+	CHECK(whole && whole->nodes().size() == 10 && whole->skippedNodes().empty());
+	auto acceptSecond = [](const char *name) { return string(name) == "L_ctrl1"; };
+	CHECK(cache.load(filePaths[1].c_str(), error, nullptr, acceptSecond, "L_ctrl1") == whole);
+	cache.remove(filePaths[1]);
+	CHECK(cache.entries().empty());
+
+	CHECK(!cache.load("animClipCoreTestMissing.json", error) && !error.empty());
+	CHECK(cache.toJson().find("\"budget\"") != string::npos);
+
+	for (const auto &filePath : filePaths)
+		remove(filePath.c_str());
+}
+
+// a clip saved over the file of a loaded clip replaces the file, the loaded clip still reads its mapped data
+static void testRewriteLoadedClip(ClipFormat format, bool compressed)
+{
+	const string filePath = string("animClipCoreTestRewrite") + (format == BinaryClipFormat ? BinaryClipExtension : ".json");
+
+	SyntheticClipParams params;
+	params.numKeys = 2000;
+	const SyntheticClip nodes = makeSyntheticClip(params);
+	CHECK(writeSyntheticClip(nodes, format, filePath, compressed));
+
+	Clip clip;
+	string error;
+	CHECK(clip.load(filePath.c_str(), error));
+
+	SyntheticClipParams smallParams;
+	smallParams.numNodes = 2;
+	smallParams.numKeys = 5;
+	const SyntheticClip smallNodes = makeSyntheticClip(smallParams);
+	CHECK(writeSyntheticClip(smallNodes, format, filePath, compressed));
+
+	compareClip(nodes, clip);
+
+	// a writer which is not closed keeps the file it would replace
+	{
+		unique_ptr<ClipWriter> writer = createClipWriter(format);
+		writer->setCompressed(compressed);
+		CHECK(writer->open(filePath.c_str()));
+		writer->beginNode("abandoned");
+		writer->endNode();
+	}
+
+	Clip rewritten;
+	CHECK(rewritten.load(filePath.c_str(), error));
+	compareClip(smallNodes, rewritten);
+
+	remove(filePath.c_str());
+}
+
+static void testQuantizedBinary()
+{
+	SyntheticClipParams params;
+	params.numKeys = 500;
+	params.numChannels = 2;
+	params.fixedTangentDensity = 0.1;
+	SyntheticClip nodes = makeSyntheticClip(params);
+
+	const string exactPath = "animClipCoreTestExact" + BinaryClipExtension;
+	const string filePath = "animClipCoreTestQuantized" + BinaryClipExtension;
+	CHECK(writeSyntheticClip(nodes, BinaryClipFormat, exactPath));
+
+	for (auto &node : nodes)
+	{
+		for (auto &curve : node.curves)
+			curve.data.tolerance = curve.attr[0] == 'r' ? 0.01 : 0.001;
+
+		for (auto &channel : node.channels)
+			channel.data.tolerance = 0.005;
+	}
+
+	// times off the tick grid and values too far apart to quantize are stored as doubles
+	for (auto &time : nodes[0].curves[0].keys.times)
+		time *= 0.1234567;
+	nodes[1].curves[0].keys.values[1] = 1e300;
+
+	CHECK(writeSyntheticClip(nodes, BinaryClipFormat, filePath));
+	CHECK(getFileSize(filePath) * 2 < getFileSize(exactPath));
+
+	Clip clip;
+	string error;
+	CHECK(clip.load(filePath.c_str(), error));
+	compareClip(nodes, clip);
+
+	const ClipNode *node = clip.findNode(nodes[0].name);
+	CHECK(node && node->curves[0].data.tolerance == 0.001);
+
+	remove(exactPath.c_str());
+	remove(filePath.c_str());
+}
+
+// identical keys are written once, every node after the first shares the curves of the first one
+static SyntheticClip makeSharedCurvesClip(const SyntheticClipParams &params)
+{
+	SyntheticClip nodes = makeSyntheticClip(params);
+
+	for (size_t n = 1; n < nodes.size(); n++)
+	{
+		for (size_t c = 0; c < nodes[n].curves.size(); c++)
+			nodes[n].curves[c].data = nodes[0].curves[c].data;
+
+		for (size_t c = 0; c < nodes[n].channels.size(); c++)
+			nodes[n].channels[c].data = nodes[0].channels[c].data;
+	}
+
+	return nodes;
+}
+
+static void testCurveDedup()
+{
+	SyntheticClipParams params;
+	params.numNodes = 6;
+	params.numKeys = 300;
+	params.numChannels = 2;
+	params.fixedTangentDensity = 0.1;
+	const SyntheticClip unique = makeSyntheticClip(params);
+
+	SyntheticClip nodes = makeSharedCurvesClip(params);
+	for (auto &node : nodes)
+	{
+		for (auto &curve : node.curves)
+			curve.data.tolerance = 0.001;
+	}
+
+	const string uniquePath = "animClipCoreTestUnique" + BinaryClipExtension;
+	const string filePath = "animClipCoreTestShared" + BinaryClipExtension;
+	CHECK(writeSyntheticClip(unique, BinaryClipFormat, uniquePath));
+	CHECK(writeSyntheticClip(nodes, BinaryClipFormat, filePath));
+	CHECK(getFileSize(filePath) * 4 < getFileSize(uniquePath));
+
+	Clip clip;
+	string error;
+	CHECK(clip.load(filePath.c_str(), error));
+	compareClip(nodes, clip);
+
+	// shared quantized keys are decoded once
+	const ClipNode *first = clip.findNode(nodes[0].name);
+	const ClipNode *last = clip.findNode(nodes.back().name);
+	CHECK(first && last && first->curves[0].data.times == last->curves[0].data.times && first->channels[1].data.values == last->channels[1].data.values);
+
+	remove(uniquePath.c_str());
+	remove(filePath.c_str());
+}
+
+static void testCurveStore()
+{
+	SyntheticClipParams params;
+	params.numNodes = 3;
+	params.numChannels = 1;
+	const SyntheticClip nodes = makeSharedCurvesClip(params);
+	const string store = "animClipCoreTestStore";
+	const string firstPath = "animClipCoreTestStoreA" + BinaryClipExtension;
+	const string secondPath = "animClipCoreTestStoreB" + BinaryClipExtension;
+
+	BinaryClipWriter firstWriter;
+	firstWriter.setCurveStore(store);
+	CHECK(writeSyntheticClip(nodes, firstWriter, firstPath));
+	CHECK(firstWriter.storedFiles().size() == nodes[0].curves.size() + nodes[0].channels.size());
+
+	// the second clip finds all of its keys in the store
+	BinaryClipWriter secondWriter;
+	secondWriter.setCurveStore(store);
+	CHECK(writeSyntheticClip(nodes, secondWriter, secondPath));
+	CHECK(secondWriter.storedFiles().empty());
+
+	for (const string &filePath : { firstPath, secondPath })
+	{
+		Clip clip;
+		string error;
+		CHECK(clip.load(filePath.c_str(), error));
+		compareClip(nodes, clip);
+	}
+
+	// stored keys in a clip claiming an older version are rejected
+	const string oldVersionPath = "animClipCoreTestStoreOld" + BinaryClipExtension;
+	{
+		string bytes;
+		{
+			MappedFile file;
+			CHECK(file.open(secondPath.c_str()));
+			bytes.assign(file.data(), file.size());
+		}
+		const uint32_t version = 3;
+		memcpy(&bytes[offsetof(BinaryClipHeader, version)], &version, sizeof(version));
+		writeFile(oldVersionPath, bytes);
+
+		Clip clip;
+		string error;
+		CHECK(!clip.load(oldVersionPath.c_str(), error) && error.find("Corrupted") != string::npos);
+		remove(oldVersionPath.c_str());
+	}
+
+	// a store file of the same size but other bytes is not trusted, its keys are written to the clip
+	const string thirdPath = "animClipCoreTestStoreC" + BinaryClipExtension;
+	{
+		string stored;
+		{
+			MappedFile file;
+			CHECK(file.open(firstWriter.storedFiles()[0].c_str()));
+			stored.assign(file.data(), file.size());
+		}
+		stored[7] ^= 0x40;
+		writeFile(firstWriter.storedFiles()[0], stored);
+
+		BinaryClipWriter thirdWriter;
+		thirdWriter.setCurveStore(store);
+		CHECK(writeSyntheticClip(nodes, thirdWriter, thirdPath));
+		CHECK(thirdWriter.storedFiles().empty());
+
+		Clip clip;
+		string error;
+		CHECK(clip.load(thirdPath.c_str(), error));
+		compareClip(nodes, clip);
+	}
+
+	for (const auto &storedFile : firstWriter.storedFiles())
+		remove(storedFile.c_str());
+
+	// keys missing from the store fail the load
+	Clip clip;
+	string error;
+	CHECK(!clip.load(secondPath.c_str(), error) && error.find("curve store") != string::npos);
+
+	remove(store.c_str());
+	remove(firstPath.c_str());
+	remove(secondPath.c_str());
+	remove(thirdPath.c_str());
+}
+
+static void testLz4()
+{
+	Random random(5);
+
+	string repetitive;
+	while (repetitive.size() < 100000)
+		repetitive += "\"spline\", \"linear\", " + to_string(random.next() % 100) + ", ";
+
+	string noise(70000, '\0');
+	for (auto &c : noise)
+		c = (char)random.next();
+
+	for (const string &data : { string(), string("a"), string("abcabcabcabcabc"), string(300, 'x'), repetitive, noise })
+	{
+		string compressed(data.size() + data.size() / 255 + 16, '\0');
+		const size_t compressedSize = lz4Compress(data.data(), data.size(), &compressed[0], compressed.size());
+		CHECK(compressedSize > 0);
+
+		string decompressed(data.size(), '\0');
+		CHECK(lz4Decompress(compressed.data(), compressedSize, &decompressed[0], decompressed.size()));
+		CHECK(decompressed == data);
+
+		// truncated input and a wrong size are detected
+		if (data.size() > 20)
+		{
+			CHECK(!lz4Decompress(compressed.data(), compressedSize / 2, &decompressed[0], decompressed.size()));
+			CHECK(!lz4Decompress(compressed.data(), compressedSize, &decompressed[0], decompressed.size() - 1));
+		}
+	}
+
+	string compressed(repetitive.size(), '\0');
+	CHECK(lz4Compress(repetitive.data(), repetitive.size(), &compressed[0], compressed.size()) * 4 < repetitive.size());
+	CHECK(lz4Compress(noise.data(), noise.size(), &compressed[0], noise.size() / 2) == 0);
+
+	// a block of LZ4_compress_default from liblz4 1.9.4, with a long literal run, a long match overlapping its output
+	// and a far match
+	string reference;
+	for (int i = 0; i < 300; i++)
+		reference += (char)(i * i * 7 + i * 13);
+	reference += string(400, 'x');
+	reference += reference.substr(0, 200);
+	reference += "end of block";
+
+	const string referenceHex =
+		"fff100143666a4f04ab228ac3ede8c4812ead0c4c6d6f4205aa2f85cce4edc7822daa074564644506a92c80c5ebe2ca832ca7024e6b69480"
+		"7a8298bcee2e7cd842ba40d47626e4b08a72686c7e9ecc0852aa1084069634e09a62381c0e0e1c38629ae03496068410aa5208cc9e7e6c68"
+		"728ab0e42676d440ba42d87c2eeebc98827a8094b6e62470ca32a82cbe5e0cc8926a5044465674a0da2278dc4ece5cf8a25a20f4d6c6c4d0"
+		"ea12488cde3eac28b24af0a466361400fa02183c6eaefc58c23ac054f6a664300af2e8ecfe1e4c88d22a90048616b4601ae2b89c8e8e9cb8"
+		"e21a60b4168604902ad2884c1efeece8f20a3064a6f654c03ac258fcae6e3c1802fa0001191f780100ff7d0fbc02b5c0656e64206f662062"
+		"6c6f636b";
+
+	string referenceBlock;
+	for (size_t i = 0; i < referenceHex.size(); i += 2)
+		referenceBlock += (char)stoi(referenceHex.substr(i, 2), nullptr, 16);
+
+	string decoded(reference.size(), '\0');
+	CHECK(lz4Decompress(referenceBlock.data(), referenceBlock.size(), &decoded[0], decoded.size()) && decoded == reference);
+
+	// and the same data round trips through our encoder
+	compressed.assign(reference.size() + 16, '\0');
+	compressed.resize(lz4Compress(reference.data(), reference.size(), &compressed[0], compressed.size()));
+	CHECK(compressed.size() > 0 && compressed.size() <= referenceBlock.size() + 16);
+	CHECK(lz4Decompress(compressed.data(), compressed.size(), &decoded[0], decoded.size()) && decoded == reference);
+}
+
+static void testCompressedClip(ClipFormat format)
+{
+	SyntheticClipParams params;
+	params.numNodes = 50;
+	params.numKeys = 1000;
+	params.numChannels = 2;
+	const SyntheticClip nodes = makeSyntheticClip(params);
+
+	const string filePath = "animClipCoreTestCompressed" + string(format == JsonClipFormat ? ".json" : BinaryClipExtension);
+	const string exactPath = "animClipCoreTestUncompressed" + string(format == JsonClipFormat ? ".json" : BinaryClipExtension);
+	CHECK(writeSyntheticClip(nodes, format, filePath, true));
+	CHECK(writeSyntheticClip(nodes, format, exactPath));
+	CHECK(getFileSize(filePath) * 3 < getFileSize(exactPath) * 2); // synthetic values are random, real clips compress better
+
+	Clip clip;
+	string error;
+	CHECK(clip.load(filePath.c_str(), error));
+	compareClip(nodes, clip);
+
+	// a damaged block is reported
+	{
+		string data;
+		{
+			MappedFile file;
+			CHECK(file.open(filePath.c_str()));
+			data.assign(file.data(), file.size());
+		}
+		CHECK(isBlockFile(data.data(), data.size()));
+
+		data[sizeof(BlockFileHeader) + 10] ^= 0x5a;
+		data[sizeof(BlockFileHeader) + 11] ^= 0x5a;
+		writeFile(filePath, data);
+
+		Clip damaged;
+		CHECK(!damaged.load(filePath.c_str(), error) && !error.empty());
+	}
+
+	remove(filePath.c_str());
+	remove(exactPath.c_str());
+}
+
+// written data is read back from the file, the compressed blocks, the data waiting for compression and the buffer
+static void testOutputRead(bool compressed)
+{
+	const size_t size = BlockFileBlockSize * (max(1u, thread::hardware_concurrency()) + 2) + 1000;
+	string data(size, '\0');
+	for (size_t i = 0; i < size; i++)
+		data[i] = (char)(i % 7 == 0 ? i * 2654435761u >> 13 : i / 64);
+
+	const string filePath = "animClipCoreTestOutput.tmp";
+	OutputFile output;
+	output.setCompressed(compressed);
+	CHECK(output.open(filePath.c_str()));
+	output.write(data.data(), data.size());
+
+	const size_t offsets[] = { 0, 100, BlockFileBlockSize - 50, BlockFileBlockSize * 2 + 7, size - 70000, size - 500 };
+	for (size_t offset : offsets)
+	{
+		string read(min<size_t>(100000, size - offset), '\0');
+		CHECK(output.read(offset, &read[0], read.size()) && read == data.substr(offset, read.size()));
+	}
+
+	// the last block read back is kept, reads going back to an earlier block still get its data
+	for (size_t offset : { size_t(10), BlockFileBlockSize + 10, size_t(20), size_t(30) })
+	{
+		string read(50, '\0');
+		CHECK(output.read(offset, &read[0], read.size()) && read == data.substr(offset, read.size()));
+	}
+
+	// writes still append after reading
+	output.write("end", 3);
+	char end[3] = {};
+	CHECK(output.read(size, end, 3) && memcmp(end, "end", 3) == 0);
+	CHECK(!output.read(size, end, 4));
+	CHECK(output.close());
+	remove(filePath.c_str());
+
+	// a discarded output leaves no file
+	CHECK(output.open(filePath.c_str()));
+	output.write(data.data(), 100);
+	output.discard();
+	CHECK(!output.isOpen() && getFileSize(filePath) == 0);
+}
+
+static void testProfiler()
+{
+	const string filePath = "animClipCoreTestProfiler.json";
+	CHECK(writeSyntheticClip(makeSyntheticClip(SyntheticClipParams()), JsonClipFormat, filePath));
+
+	Profiler profiler;
+	Clip clip;
+	string error;
+	CHECK(clip.load(filePath.c_str(), error, &profiler));
+	CHECK(profiler.count("bytes") == 0); // disabled
+
+	profiler.setEnabled(true);
+	Clip profiledClip;
+	CHECK(profiledClip.load(filePath.c_str(), error, &profiler));
+	CHECK(profiler.count("bytes") == getFileSize(filePath));
+	CHECK(profiler.time("parse") > 0);
+
+	const string json = profiler.toJson("test", filePath);
+	CHECK(json.find("\"parse\"") != string::npos);
+	CHECK(json.find("\"bytes\"") != string::npos);
+
+	remove(filePath.c_str());
+}
+
+// linear interpolation of the reduced keys at every original key time
+static double getReductionError(const CurveData &curve, const CurveData &reduced)
+{
+	double maxError = 0;
+	size_t k = 0;
+	for (size_t i = 0; i < curve.numKeys; i++)
+	{
+		while (k + 2 < reduced.numKeys && reduced.times[k + 1] < curve.times[i])
+			k++;
+
+		const double t = (curve.times[i] - reduced.times[k]) / (reduced.times[k + 1] - reduced.times[k]);
+		const double value = reduced.values[k] + t * (reduced.values[k + 1] - reduced.values[k]);
+		maxError = max(maxError, fabs(value - curve.values[i]));
+	}
+	return maxError;
+}
+
+static void testKeyReduction()
+{
+	// a key per frame with spline tangents, as baked or mocap curves are
+	CurveKeys keys;
+	for (int i = 0; i < 2000; i++)
+	{
+		keys.times.push_back(i);
+		keys.values.push_back(i < 1000 ? 90 * sin(i * 0.01) : 5.0);
+		keys.inTangentTypes.push_back(4);
+		keys.outTangentTypes.push_back(4);
+	}
+
+	CurveData curve;
+	curve.setKeys(keys);
+
+	CurveKeys reducedKeys;
+	CurveData reduced;
+	double maxError = 0;
+	CHECK(reduceCurve(curve, 0.01, reducedKeys, reduced, maxError));
+	CHECK(reduced.numKeys < curve.numKeys / 4);
+	CHECK(reduced.times[0] == 0 && reduced.times[reduced.numKeys - 1] == 1999);
+	CHECK(reduced.inTangentTypes[0] == TangentLinear && reduced.outTangentTypes[0] == TangentLinear);
+	CHECK(maxError <= 0.01 && isClose(maxError, getReductionError(curve, reduced)));
+
+	CHECK(!reduceCurve(curve, 0, reducedKeys, reduced, maxError));
+
+	// sparse spline keys and fixed tangents are not reproduced by linear keys
+	CurveKeys sparseKeys = keys;
+	sparseKeys.times[1] = 1.5;
+	curve.setKeys(sparseKeys);
+	CHECK(!reduceCurve(curve, 0.01, reducedKeys, reduced, maxError));
+
+	CurveKeys fixedKeys = keys;
+	fixedKeys.inTangentTypes[10] = TangentFixed;
+	curve.setKeys(fixedKeys);
+	CHECK(!reduceCurve(curve, 0.01, reducedKeys, reduced, maxError));
+
+	// nothing is reduced when every key is needed or keys share a time
+	CurveKeys zigzagKeys = keys;
+	for (size_t i = 0; i < zigzagKeys.size(); i++)
+		zigzagKeys.values[i] = i % 2;
+	curve.setKeys(zigzagKeys);
+	CHECK(!reduceCurve(curve, 0.01, reducedKeys, reduced, maxError) && reducedKeys.size() == 0);
+
+	CurveKeys equalTimeKeys = keys;
+	equalTimeKeys.times[11] = equalTimeKeys.times[10];
+	curve.setKeys(equalTimeKeys);
+	CHECK(!reduceCurve(curve, 0.01, reducedKeys, reduced, maxError));
+
+	// enough keys to run on several threads, only angular curves have a tolerance
+	curve.setKeys(keys);
+	vector<ReductionJob> jobs(16);
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		jobs[i].curve = &curve;
+		jobs[i].animCurveType = i % 2 ? 0 : 1; // animCurveTA, animCurveTL
+	}
+
+	CurveTolerances tolerances;
+	CHECK(!tolerances.isEnabled());
+	tolerances.angular = 0.1;
+	CHECK(tolerances.isEnabled() && tolerances.get(4) == 0.1 && tolerances.get(5) == 0);
+
+	reduceCurves(jobs, tolerances);
+
+	ReductionStats stats;
+	for (const auto &job : jobs)
+	{
+		CHECK(job.isReduced == (job.animCurveType == 0));
+		CHECK(job.isReduced ? job.result.numKeys == jobs[1].result.numKeys : job.result.numKeys == curve.numKeys);
+		CHECK(getReductionError(curve, job.result) <= 0.1);
+		if (job.isReduced)
+			stats.add(curve, job.result, job.animCurveType, job.maxError);
+	}
+
+	CHECK(stats.curves == 8 && stats.keysBefore == 8 * curve.numKeys && stats.keysAfter < stats.keysBefore);
+	CHECK(stats.maxError[0] <= 0.1 && stats.maxError[1] == 0);
+}
+
+// baked channels keep the channel encoding unless reduction makes them a much shorter curve, so reducing never grows a baked clip
+static void testChannelReduction(ClipFormat format)
+{
+	const size_t numSamples = 600;
+	vector<vector<double>> samples(4, vector<double>(numSamples));
+	for (size_t i = 0; i < numSamples; i++)
+	{
+		samples[0][i] = 90 * sin(i * 0.01); // reduced
+		samples[1][i] = i * 0.1 + (i % 2) * 0.5; // linear, no tolerance
+		samples[2][i] = (double)(i % 2); // every key needed
+		samples[3][i] = (i % 3) * 5.0; // a third of the keys removed
+	}
+	const int animCurveTypes[] = { 0, 1, 3, 0 }; // animCurveTA, animCurveTL, animCurveTU, animCurveTA
+
+	CurveTolerances tolerances;
+	tolerances.angular = 0.01;
+	tolerances.unitless = 0.01;
+
+	ChannelReducer reducer;
+	for (size_t c = 0; c < samples.size(); c++)
+	{
+		ChannelData channel;
+		channel.unit = 6;
+		channel.numValues = numSamples;
+		channel.values = samples[c].data();
+		reducer.add(channel, animCurveTypes[c]);
+	}
+
+	const string extension = format == BinaryClipFormat ? BinaryClipExtension : ".json";
+	const string channelPath = "animClipCoreTestBaked" + extension;
+	const string reducedPath = "animClipCoreTestBakedReduced" + extension;
+	const string attrs[] = { "rx", "tx", "v", "ry" };
+
+	unique_ptr<ClipWriter> writer = createClipWriter(format);
+	CHECK(writer->open(channelPath.c_str()));
+	writer->beginNode("node");
+	for (size_t i = 0; i < reducer.size(); i++)
+		writer->writeChannel(attrs[i].c_str(), reducer.channel(i));
+	writer->endNode();
+	CHECK(writer->close());
+
+	reducer.reduce(tolerances);
+	CHECK(reducer.reduced(0) && !reducer.reduced(1) && !reducer.reduced(2) && !reducer.reduced(3));
+
+	CHECK(writer->open(reducedPath.c_str()));
+	writer->beginNode("node");
+	for (size_t i = 0; i < reducer.size(); i++)
+	{
+		if (reducer.reduced(i))
+			writer->writeCurve(attrs[i].c_str(), reducer.reduced(i)->result);
+	}
+	for (size_t i = 0; i < reducer.size(); i++)
+	{
+		if (!reducer.reduced(i))
+			writer->writeChannel(attrs[i].c_str(), reducer.channel(i));
+	}
+	writer->endNode();
+	CHECK(writer->close());
+
+	CHECK(getFileSize(reducedPath) < getFileSize(channelPath));
+
+	Clip clip;
+	string error;
+	CHECK(clip.load(reducedPath.c_str(), error));
+	const ClipNode *node = clip.findNode("node");
+	CHECK(node && node->curves.size() == 1 && node->channels.size() == 3);
+	if (node && node->curves.size() == 1 && node->channels.size() == 3)
+	{
+		CurveKeys keys;
+		CurveData curve;
+		getChannelCurveData(reducer.channel(0), keys, curve);
+		CHECK(string(node->curves[0].attr) == "rx" && getReductionError(curve, node->curves[0].data) <= tolerances.angular + 1e-9);
+
+		for (size_t c = 0; c < 3; c++)
+		{
+			const ChannelData &channel = node->channels[c].data;
+			CHECK(string(node->channels[c].attr) == attrs[c + 1]);
+			bool valuesEqual = channel.numValues == numSamples;
+			for (size_t k = 0; k < numSamples && valuesEqual; k++)
+				valuesEqual = isClose(channel.values[k], samples[c + 1][k]);
+			CHECK(valuesEqual);
+		}
+	}
+
+	reducer.clear();
+	CHECK(reducer.size() == 0);
+
+	remove(channelPath.c_str());
+	remove(reducedPath.c_str());
+}
+
+static void testConstantCurve()
+{
+	CurveKeys keys;
+	for (int i = 0; i < 10; i++)
+	{
+		keys.times.push_back(i);
+		keys.values.push_back(5);
+		keys.inTangentTypes.push_back(4);
+		keys.outTangentTypes.push_back(4);
+	}
+
+	CurveData curve;
+	curve.setKeys(keys);
+
+	double value = 0;
+	CHECK(isConstantCurve(curve, 0, value) && value == 5);
+
+	// values within the tolerance fold to the middle of their range
+	keys.values[3] = 5.02;
+	curve.setKeys(keys);
+	CHECK(!isConstantCurve(curve, 0, value));
+	CHECK(isConstantCurve(curve, 0.01, value) && isClose(value, 5.01));
+	CHECK(!isConstantCurve(curve, 0.005, value));
+
+	// inexact values would drift with relative cycles
+	curve.postInfinity = InfinityCycleRelative;
+	CHECK(!isConstantCurve(curve, 0.01, value));
+
+	keys.values[3] = 5;
+	curve.setKeys(keys);
+	CHECK(isConstantCurve(curve, 0, value));
+
+	// a flat fixed tangent keeps the value, a sloped one leaves it
+	FixedTangent fixed = {};
+	fixed.key = 4;
+	keys.inTangentTypes[4] = TangentFixed;
+	keys.fixedTangents.push_back(fixed);
+	curve.setKeys(keys);
+	CHECK(isConstantCurve(curve, 0, value));
+
+	keys.fixedTangents[0].outAngle = 0.1;
+	curve.setKeys(keys);
+	CHECK(!isConstantCurve(curve, 0, value));
+
+	CurveData empty;
+	CHECK(!isConstantCurve(empty, 1, value));
+
+	const double samples[] = { 2, 2, 2.001, 2 };
+	ChannelData channel;
+	channel.values = samples;
+	channel.numValues = 4;
+	CHECK(!isConstantChannel(channel, 0, value));
+	CHECK(isConstantChannel(channel, 0.001, value) && isClose(value, 2.0005));
+}
+
+static void testCurveEvaluator()
+{
+	CurveKeys keys;
+	const double times[] = { 0, 10, 20, 30 };
+	const double values[] = { 0, 10, 0, 5 };
+	for (int i = 0; i < 4; i++)
+	{
+		keys.times.push_back(times[i]);
+		keys.values.push_back(values[i]);
+		keys.inTangentTypes.push_back(TangentLinear);
+		keys.outTangentTypes.push_back(TangentLinear);
+	}
+
+	CurveData curve;
+	curve.setKeys(keys);
+	curve.unit = 6;
+
+	CurveEvaluator evaluator;
+	evaluator.prepare(curve, false);
+	CHECK(canEvaluate(curve) && evaluator.numKeys() == 4 && evaluator.unit() == 6);
+	CHECK(isClose(evaluator.evaluate(5), 5) && isClose(evaluator.evaluate(15), 5) && isClose(evaluator.evaluate(25), 2.5) && evaluator.evaluate(30) == 5);
+
+	// playback forwards and backwards from the segment of the last call
+	size_t segment = 0;
+	bool sequenceEqual = true;
+	for (double t = 0; t <= 30; t += 0.5)
+		sequenceEqual &= isClose(evaluator.evaluate(t, segment), evaluator.evaluate(t));
+	for (double t = 30; t >= 0; t -= 0.5)
+		sequenceEqual &= isClose(evaluator.evaluate(t, segment), evaluator.evaluate(t));
+	CHECK(sequenceEqual);
+
+	// constant infinities hold the end values, linear ones extend the end slopes
+	CHECK(evaluator.evaluate(-5) == 0 && evaluator.evaluate(40) == 5);
+	curve.preInfinity = InfinityLinear;
+	curve.postInfinity = InfinityLinear;
+	evaluator.prepare(curve, false);
+	CHECK(isClose(evaluator.evaluate(-5), -5) && isClose(evaluator.evaluate(40), 10));
+
+	curve.postInfinity = InfinityCycle;
+	evaluator.prepare(curve, false);
+	CHECK(isClose(evaluator.evaluate(35), 5) && isClose(evaluator.evaluate(85), 2.5));
+
+	curve.postInfinity = InfinityCycleRelative;
+	evaluator.prepare(curve, false);
+	CHECK(isClose(evaluator.evaluate(35), 10) && isClose(evaluator.evaluate(65), 15));
+
+	curve.preInfinity = InfinityOscillate;
+	evaluator.prepare(curve, false);
+	CHECK(isClose(evaluator.evaluate(-5), 5) && isClose(evaluator.evaluate(-25), 2.5) && isClose(evaluator.evaluate(-35), 2.5));
+
+	// stepped keys hold their value, stepnext keys the value of the next key
+	keys.outTangentTypes[0] = TangentStep;
+	keys.outTangentTypes[1] = TangentStepNext;
+	curve.setKeys(keys);
+	evaluator.prepare(curve, false);
+	CHECK(evaluator.evaluate(9.9) == 0 && evaluator.evaluate(10) == 10 && evaluator.evaluate(10.1) == 0);
+
+	// spline tangents of a point symmetric curve give a point symmetric segment
+	for (int i = 0; i < 4; i++)
+	{
+		keys.inTangentTypes[i] = TangentSpline;
+		keys.outTangentTypes[i] = TangentSpline;
+	}
+	keys.values[3] = 10;
+	curve.setKeys(keys);
+	evaluator.prepare(curve, false);
+	CHECK(isClose(evaluator.evaluate(12) + evaluator.evaluate(18), 10) && isClose(evaluator.evaluate(15), 5) && evaluator.evaluate(12) < 10);
+
+	// tangent types without a known rule are left to MFnAnimCurve
+	const uint8_t unknownTypes[] = { TangentClamped, TangentPlateau, TangentAuto };
+	for (uint8_t type : unknownTypes)
+	{
+		CurveKeys unknown = keys;
+		unknown.outTangentTypes[2] = type;
+		CurveData unknownCurve;
+		unknownCurve.setKeys(unknown);
+		CHECK(!canEvaluate(unknownCurve));
+	}
+
+	// a flat fixed tangent flattens the spline, angles are in internal units per second
+	keys.fixedTangents.push_back({});
+	keys.fixedTangents[0].key = 1;
+	keys.inTangentTypes[1] = TangentFixed;
+	keys.outTangentTypes[1] = TangentFixed;
+	curve.setKeys(keys);
+	evaluator.prepare(curve, false);
+	CHECK(evaluator.evaluate(9) < 10 && evaluator.evaluate(11) < 10 && isClose(evaluator.evaluate(10), 10));
+
+	// channels are linear between their samples
+	const double samples[] = { 1, 3, 2 };
+	ChannelData channel;
+	channel.start = 5;
+	channel.step = 2;
+	channel.numValues = 3;
+	channel.values = samples;
+	evaluator.prepare(channel);
+	CHECK(evaluator.evaluate(4) == 1 && isClose(evaluator.evaluate(6), 2) && isClose(evaluator.evaluate(8), 2.5) && evaluator.evaluate(10) == 2);
+}
+
+static void testWeightedCurve()
+{
+	// ease in and out between two keys, fixed tangents of every key
+	CurveKeys keys;
+	for (int i = 0; i < 3; i++)
+	{
+		keys.times.push_back(i * 24);
+		keys.values.push_back(i % 2 ? 10 : 0);
+		keys.inTangentTypes.push_back(TangentFixed);
+		keys.outTangentTypes.push_back(TangentFixed);
+
+		FixedTangent fixed = {};
+		fixed.key = i;
+		fixed.inX = fixed.outX = 1; // a third of the 24 frame segments, three times in seconds
+		keys.fixedTangents.push_back(fixed);
+	}
+
+	CurveData curve;
+	curve.setKeys(keys);
+	curve.unit = 6;
+	curve.weighted = true;
+
+	// weights of a third of the segment give the non-weighted curve
+	CurveEvaluator weighted, hermite;
+	weighted.prepare(curve, false);
+	curve.weighted = false;
+	hermite.prepare(curve, false);
+	CHECK(isClose(weighted.evaluate(6), hermite.evaluate(6)) && isClose(weighted.evaluate(30), hermite.evaluate(30)));
+
+	// heavier weights stay longer near the keys, the segment stays point symmetric
+	for (auto &fixed : keys.fixedTangents)
+		fixed.inX = fixed.outX = 2.7;
+	curve.setKeys(keys);
+	curve.weighted = true;
+	weighted.prepare(curve, false);
+	CHECK(weighted.evaluate(6) < hermite.evaluate(6) && isClose(weighted.evaluate(6) + weighted.evaluate(18), 10) && isClose(weighted.evaluate(12), 5));
+	CHECK(weighted.evaluate(24) == 10 && isClose(weighted.evaluate(0.5), weighted.evaluate(47.5)));
+
+	// sloped tangents are in internal units per second, degrees per frame for angular curves
+	keys.fixedTangents[0].outY = 2.7 * 24 * 0.1 * DegreesToRadians;
+	curve.setKeys(keys);
+	weighted.prepare(curve, true);
+	CHECK(isWithin(0.1, weighted.evaluate(0.01) / 0.01, 1e-3));
+
+	bool increasing = true;
+	for (double t = 0.5; t < 24; t += 0.5)
+		increasing &= weighted.evaluate(t) > weighted.evaluate(t - 0.5);
+	CHECK(increasing);
+}
+
+static void testCurveSampling()
+{
+	CurveKeys keys;
+	for (int i = 0; i < 50; i++)
+	{
+		keys.times.push_back(i * 3);
+		keys.values.push_back(sin(i * 0.7) * 10);
+		keys.inTangentTypes.push_back((uint8_t)(i % 4 == 0 ? TangentLinear : TangentSpline));
+		keys.outTangentTypes.push_back((uint8_t)(i % 7 == 0 ? TangentStepNext : i % 5 == 0 ? TangentStep : TangentSpline));
+	}
+
+	CurveData curve;
+	curve.setKeys(keys);
+	curve.preInfinity = InfinityOscillate;
+	curve.postInfinity = InfinityCycleRelative;
+
+	CurveEvaluator first, second;
+	first.prepare(curve, false);
+	keys.values[10] = 100;
+	curve.setKeys(keys);
+	second.prepare(curve, false);
+
+	// ascending times inside and outside the keys, then the same times in reverse
+	vector<double> times;
+	for (double t = -200; t < 400; t += 0.25)
+		times.push_back(t);
+	vector<double> reversed(times.rbegin(), times.rend());
+
+	vector<double> values(times.size() * 2);
+	sampleCurves({ &first, &second }, times.data(), times.size(), values.data());
+
+	vector<double> reversedValues(times.size());
+	second.sample(reversed.data(), reversed.size(), reversedValues.data());
+
+	bool valuesEqual = true;
+	for (size_t i = 0; i < times.size(); i++)
+	{
+		valuesEqual &= isClose(values[i], first.evaluate(times[i]));
+		valuesEqual &= isClose(values[times.size() + i], second.evaluate(times[i]));
+		valuesEqual &= isClose(reversedValues[times.size() - 1 - i], values[times.size() + i]);
+	}
+	CHECK(valuesEqual);
+}
+
+static void testCurvePaste()
+{
+	// existing keys every 10 frames from 0 to 50, pasted keys at 0, 5 and 10 shifted to 20
+	CurveKeys existingKeys, pastedKeys, result;
+	for (int i = 0; i <= 5; i++)
+	{
+		existingKeys.times.push_back(i * 10);
+		existingKeys.values.push_back(i);
+		existingKeys.inTangentTypes.push_back(TangentSpline);
+		existingKeys.outTangentTypes.push_back(TangentSpline);
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		pastedKeys.times.push_back(i * 5);
+		pastedKeys.values.push_back(100 + i);
+		pastedKeys.inTangentTypes.push_back(TangentLinear);
+		pastedKeys.outTangentTypes.push_back(TangentLinear);
+	}
+
+	FixedTangent fixed = {};
+	fixed.key = 4;
+	fixed.inAngle = 0.5;
+	existingKeys.inTangentTypes[4] = TangentFixed;
+	existingKeys.fixedTangents.push_back(fixed);
+	fixed.key = 1;
+	fixed.inAngle = 0.25;
+	pastedKeys.inTangentTypes[1] = TangentFixed;
+	pastedKeys.fixedTangents.push_back(fixed);
+
+	CurveData existing, pasted;
+	existing.setKeys(existingKeys);
+	pasted.setKeys(pastedKeys);
+
+	double start, end;
+	getPasteRange(pasted, 20, PasteReplace, start, end);
+	CHECK(start == 20 && end == 30);
+	getPasteRange(pasted, 20, PasteInsert, start, end);
+	CHECK(start == 20 && end > 1e300);
+
+	// merge keeps the key at 30 and replaces the one at 20
+	pasteKeys(existing, pasted, 20, PasteMerge, result);
+	CHECK((result.times == vector<double>{ 0, 10, 20, 25, 30, 40, 50 }));
+	CHECK(result.values[2] == 100 && result.values[4] == 102 && result.values[5] == 4);
+	CHECK(result.fixedTangents.size() == 2 && result.fixedTangents[0].key == 3 && result.fixedTangents[0].inAngle == 0.25);
+	CHECK(result.fixedTangents[1].key == 5 && result.fixedTangents[1].inAngle == 0.5);
+
+	// replace removes the keys from 20 to 30
+	pasteKeys(existing, pasted, 20, PasteReplace, result);
+	CHECK((result.times == vector<double>{ 0, 10, 20, 25, 30, 40, 50 }) && result.values[4] == 102);
+
+	pasteKeys(existing, pasted, 21, PasteReplace, result);
+	CHECK((result.times == vector<double>{ 0, 10, 20, 21, 26, 31, 40, 50 }) && result.values[2] == 2 && result.values[6] == 4);
+
+	// insert shifts the keys from 20 on after the pasted ones
+	pasteKeys(existing, pasted, 20, PasteInsert, result);
+	CHECK((result.times == vector<double>{ 0, 10, 20, 25, 30, 31, 41, 51, 61 }) && result.values[5] == 2 && result.values[8] == 5);
+	CHECK(result.fixedTangents.size() == 2 && result.fixedTangents[1].key == 7);
+
+	CHECK(findPasteMode("insert") == PasteInsert && findPasteMode("paste") == -1);
+}
+
+static void testKeyJournal()
+{
+	CurveKeys first, second;
+	for (int i = 0; i < 4; i++)
+	{
+		first.times.push_back(i);
+		first.values.push_back(i * 2);
+		first.inTangentTypes.push_back(TangentSpline);
+		first.outTangentTypes.push_back(TangentSpline);
+	}
+	second = first;
+	second.times.resize(3);
+	second.values.assign({ 7, 8, 9 });
+	second.inTangentTypes.resize(3);
+	second.outTangentTypes.resize(3);
+
+	FixedTangent fixed = {};
+	fixed.key = 2;
+	fixed.outWeight = 3;
+	second.fixedTangents.push_back(fixed);
+
+	CurveData firstCurve, secondCurve;
+	firstCurve.setKeys(first);
+	secondCurve.setKeys(second);
+	secondCurve.weighted = true;
+	secondCurve.unit = 6;
+
+	KeyJournal journal;
+	CHECK(journal.add(firstCurve) == 0 && journal.add(CurveData()) == 1 && journal.add(secondCurve) == 2);
+	CHECK(journal.size() == 3);
+	CHECK(journal.memorySize() == KeyJournal::memorySize(firstCurve) + KeyJournal::memorySize(CurveData()) + KeyJournal::memorySize(secondCurve));
+
+	// fixed tangents keep indices relative to their curve
+	const CurveData restored = journal.get(2);
+	CHECK(restored.numKeys == 3 && restored.values[0] == 7 && restored.times[2] == 2);
+	CHECK(restored.weighted && restored.unit == 6);
+	CHECK(restored.numFixedTangents == 1 && restored.fixedTangents[0].key == 2 && restored.fixedTangents[0].outWeight == 3);
+	CHECK(journal.get(0).numKeys == 4 && journal.get(0).values[3] == 6 && journal.get(0).numFixedTangents == 0);
+	CHECK(journal.get(1).numKeys == 0);
+
+	// a range without keys still keeps the weighted flag, undo restores it for a paste changing the flag
+	CurveData weightedRange;
+	weightedRange.weighted = true;
+	CHECK(journal.add(weightedRange) == 3);
+	CHECK(journal.get(3).numKeys == 0 && journal.get(3).weighted && !journal.get(1).weighted);
+
+	journal.clear();
+	CHECK(journal.size() == 0 && journal.memorySize() == 0);
+}
+
+int main()
+{
+	CHECK(getClipFormat("c:/clip.json") == JsonClipFormat);
+	CHECK(getClipFormat("/clips/walk" + BinaryClipExtension) == BinaryClipFormat);
+	CHECK(findTangentType("spline") == 4);
+	CHECK(findTangentType("unknown") == -1);
+
+	for (ClipFormat format : { JsonClipFormat, BinaryClipFormat })
+	{
+		testRoundTrip(format, 1, 1, 0, false);
+		testRoundTrip(format, 20, 12, 100, false);
+		testRoundTrip(format, 20, 12, 100, true);
+		testRoundTrip(format, 100, 10, 1000, true);
+		testRoundTrip(format, 20, 3, 100, false, 6);
+		testRoundTrip(format, 5, 0, 50, false, 3);
+	}
+
+	testStringTable();
+	testCorruptedBinary();
+	testQuantizedBinary();
+	testCurveDedup();
+	testCurveStore();
+	testLz4();
+	testCompressedClip(JsonClipFormat);
+	testCompressedClip(BinaryClipFormat);
+	testOutputRead(false);
+	testOutputRead(true);
+	testJsonInSitu();
+	testNodeFilter(JsonClipFormat);
+	testNodeFilter(BinaryClipFormat);
+	testClipCache();
+	for (ClipFormat format : { JsonClipFormat, BinaryClipFormat })
+	{
+		testRewriteLoadedClip(format, false);
+		testRewriteLoadedClip(format, true);
+	}
+	testProfiler();
+	testKeyReduction();
+	testChannelReduction(JsonClipFormat);
+	testChannelReduction(BinaryClipFormat);
+	testConstantCurve();
+	testCurveEvaluator();
+	testWeightedCurve();
+	testCurveSampling();
+	testCurvePaste();
+	testKeyJournal();
+
+	if (failures)
+		printf("%d checks failed\n", failures);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,53 @@
+# Loads a clip twice onto the same targets in mayapy. The first load creates the curves, the second reuses its apply plan
+# and pastes into those curves. Usage: mayapy loadAnimClipTest.py <animClip plugin path>
+
+import json
+import os
+import sys
+import tempfile
+
+import maya.standalone
+maya.standalone.initialize()
+
+import maya.cmds as cmds
+
+failures = 0
+
+def check(condition, message):
+    global failures
+    if not condition:
+        print("FAILED " + message)
+        failures += 1
+
+def loadCounters(filePath):
+    report = cmds.loadAnimClip(f=filePath, ns="target", p=True)
+    return json.loads(report)["counters"]
+
+cmds.loadPlugin(sys.argv[1])
+
+source = cmds.createNode("transform", name="box")
+cmds.setKeyframe(source, attribute="tx", time=1, value=0)
+cmds.setKeyframe(source, attribute="tx", time=10, value=5)
+
+filePath = os.path.join(tempfile.gettempdir(), "loadAnimClipTest.json")
+cmds.select(source)
+cmds.saveAnimClip(f=filePath, sf=1, ef=10)
+
+cmds.namespace(add="target")
+target = cmds.createNode("transform", name="target:box")
+cmds.select(clear=True) # selected nodes would take precedence over the namespace
+
+first = loadCounters(filePath)
+check(first.get("planHits", 0) == 0, "the first load makes its plan")
+
+second = loadCounters(filePath)
+check(second.get("planHits", 0) == 1, "the second load reuses the plan of the first")
+
+curves = cmds.listConnections(target + ".tx", source=True, destination=False, type="animCurve") or []
+check(len(curves) == 1, "the second load pastes into the curve of the first")
+check(cmds.keyframe(target + ".tx", query=True, keyframeCount=True) == 2, "the pasted keys replace the keys of the first load")
+
+os.remove(filePath)
+
+maya.standalone.uninitialize()
+sys.exit(1 if failures else 0)
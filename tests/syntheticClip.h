@@ -0,0 +1,203 @@
+#pragma once
+
+// Reproducible synthetic clips in the layout saveAnimClip writes, shared by the core test and the benchmark.
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "clip.h"
+
+using namespace std;
+
+struct SyntheticClipParams
+{
+	int numNodes = 10;
+	int numCurves = 9; // per node
+	int numKeys = 100; // per curve
+	int numChannels = 0; // baked channels per node, numKeys values each
+	bool weighted = false;
+	double fixedTangentDensity = 0; // fraction of keys with fixed tangents
+	uint32_t seed = 17;
+};
+
+struct SyntheticCurve
+{
+	string attr;
+	CurveKeys keys;
+	CurveData data;
+};
+
+struct SyntheticChannel
+{
+	string attr;
+	vector<double> values;
+	ChannelData data;
+};
+
+struct SyntheticNode
+{
+	string name;
+	vector<SyntheticCurve> curves;
+	vector<SyntheticChannel> channels;
+	vector<pair<string, double>> statics;
+};
+
+typedef vector<SyntheticNode> SyntheticClip;
+
+// deterministic pseudo random numbers, so every run makes the same clip
+class Random
+{
+public:
+	Random(uint32_t seed) : m_state(seed) {}
+
+	uint32_t next() { m_state = m_state * 1664525u + 1013904223u; return m_state >> 8; }
+	double uniform() { return next() / double(1 << 24); }
+
+private:
+	uint32_t m_state;
+};
+
+inline SyntheticClip makeSyntheticClip(const SyntheticClipParams &params)
+{
+	static const char *attrs[] = { "tx", "ty", "tz", "rx", "ry", "rz", "sx", "sy", "sz", "v" };
+	static const uint8_t tangentTypes[] = { 2, 3, 4, 5, 8, 9, 10, 11 }; // linear, flat, spline, step, clamped, plateau, stepnext, auto
+
+	Random random(params.seed);
+	SyntheticClip nodes(params.numNodes);
+
+	for (int n = 0; n < params.numNodes; n++)
+	{
+		SyntheticNode &node = nodes[n];
+		node.name = (n % 2 ? "L_ctrl" : "R_ctrl") + to_string(n);
+		node.curves.resize(params.numCurves);
+
+		for (int c = 0; c < params.numCurves; c++)
+		{
+			SyntheticCurve &curve = node.curves[c];
+			curve.attr = attrs[c % 10] + (c >= 10 ? to_string(c) : string());
+			curve.data.weighted = params.weighted;
+			curve.data.preInfinity = c % 5;
+			curve.data.postInfinity = (c + 1) % 5;
+			curve.data.unit = 6;
+
+			curve.keys.times.reserve(params.numKeys);
+			curve.keys.values.reserve(params.numKeys);
+			curve.keys.inTangentTypes.reserve(params.numKeys);
+			curve.keys.outTangentTypes.reserve(params.numKeys);
+
+			double t = floor(random.uniform() * 10);
+			double v = (random.uniform() - 0.5) * 100;
+
+			for (int k = 0; k < params.numKeys; k++)
+			{
+				uint8_t itt = tangentTypes[random.next() % 8];
+				uint8_t ott = random.next() % 4 ? itt : tangentTypes[random.next() % 8];
+
+				if (random.uniform() < params.fixedTangentDensity)
+				{
+					if (random.next() % 2)
+						itt = TangentFixed;
+					else
+						ott = TangentFixed;
+
+					FixedTangent ft = {};
+					ft.key = (uint32_t)curve.keys.size();
+					ft.weightsLocked = random.next() % 2;
+					ft.tangentsLocked = random.next() % 2;
+					ft.inAngle = random.uniform() - 0.5;
+					ft.outAngle = random.uniform() - 0.5;
+					ft.inWeight = random.uniform();
+					ft.outWeight = random.uniform();
+
+					if (params.weighted)
+					{
+						ft.inX = random.uniform();
+						ft.inY = random.uniform();
+						ft.outX = random.uniform();
+						ft.outY = random.uniform();
+					}
+
+					curve.keys.fixedTangents.push_back(ft);
+				}
+
+				curve.keys.times.push_back(t);
+				curve.keys.values.push_back(v);
+				curve.keys.inTangentTypes.push_back(itt);
+				curve.keys.outTangentTypes.push_back(ott);
+
+				t += 1 + floor(random.uniform() * 3);
+				v += (random.uniform() - 0.5) * 10;
+			}
+
+			curve.data.setKeys(curve.keys);
+		}
+
+		node.channels.resize(params.numChannels);
+		for (int c = 0; c < params.numChannels; c++)
+		{
+			SyntheticChannel &channel = node.channels[c];
+			channel.attr = "baked" + to_string(c);
+
+			double v = (random.uniform() - 0.5) * 100;
+			for (int k = 0; k < params.numKeys; k++)
+			{
+				channel.values.push_back(v);
+				v += (random.uniform() - 0.5) * 10;
+			}
+
+			channel.data.unit = 6;
+			channel.data.start = floor(random.uniform() * 10);
+			channel.data.step = c % 2 ? 0.5 : 1;
+			channel.data.numValues = channel.values.size();
+			channel.data.values = channel.values.data();
+		}
+
+		node.statics.push_back(make_pair("ro", double(n % 6)));
+		node.statics.push_back(make_pair("v", floor(random.uniform() * 2)));
+	}
+
+	return nodes;
+}
+
+inline size_t getNumKeys(const SyntheticClip &nodes)
+{
+	size_t numKeys = 0;
+	for (const auto &node : nodes)
+	{
+		for (const auto &curve : node.curves)
+			numKeys += curve.keys.size();
+	}
+	return numKeys;
+}
+
+inline bool writeSyntheticClip(const SyntheticClip &nodes, ClipWriter &writer, const string &filePath)
+{
+	if (!writer.open(filePath.c_str()))
+		return false;
+
+	for (const auto &node : nodes)
+	{
+		writer.beginNode(node.name.c_str());
+
+		for (const auto &curve : node.curves)
+			writer.writeCurve(curve.attr.c_str(), curve.data);
+
+		for (const auto &channel : node.channels)
+			writer.writeChannel(channel.attr.c_str(), channel.data);
+
+		for (const auto &attrValue : node.statics)
+			writer.writeStatic(attrValue.first.c_str(), attrValue.second);
+
+		writer.endNode();
+	}
+
+	return writer.close();
+}
+
+inline bool writeSyntheticClip(const SyntheticClip &nodes, ClipFormat format, const string &filePath, bool compressed = false)
+{
+	unique_ptr<ClipWriter> writer = createClipWriter(format);
+	writer->setCompressed(compressed);
+	return writeSyntheticClip(nodes, *writer, filePath);
+}